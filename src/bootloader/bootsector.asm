@@ -9,22 +9,28 @@
 
 KERNEL_OFFSET equ 0x007e00	; Смещение в памяти, из которого мы загрузим ядро
 
+%ifndef KERNEL_SECTORS
+	%define KERNEL_SECTORS 192	; Сколько секторов ядра читать (задается из Makefile)
+%endif
+
 	mov [BOOT_DRIVE], dl	; BIOS хранит наш загрузочный диск в формате DL, поэтому
 							; лучше запомнить это на будущее. (Помните об этом
 							; BIOS задает нам загрузочный диск в формате "dl" при загрузке)
-	mov bp, 0xA0000			; Устанавливаем стек
-	mov sp, bp
+	mov bp, 0x7c00			; Устанавливаем стек под загрузочным сектором,
+	mov sp, bp				; чтобы ядро, читаемое с 0x7e00, его не затерло
 
 	mov bx, MSG_REAL_MODE	; Печатаем сообщение
 	call puts_chars
 
 	call load_kernel		; Загружаем ядро
+	call detect_memory_map	; Запоминаем карту памяти BIOS, пока есть доступ к int 0x15
 	call switch_to_pm		; Переключаемся в Защищенный Режим
 	jmp $
 
 %include "src/bootloader/puts_chars.asm"		; Вывод строки
 %include "src/bootloader/puts_hex.asm"			; ф. печати 16-ричного числа
 %include "src/bootloader/diskload.asm"			; ф. чтения диска
+%include "src/bootloader/memmap.asm"			; Карта памяти E820
 %include "src/bootloader/puts_chars32.asm"		; Вывод строки в 32 PM
 %include "src/bootloader/switch_to32.asm"		; Переключиться на 32 PM
 %include "src/bootloader/gdt.asm"				; GDT
@@ -35,9 +41,9 @@ load_kernel:
 	mov bx, MSG_LOAD_KERNEL
 	call puts_chars			; Печатаем сообщение о том, то мы загружаем ядро
 							; Устанавливаем параметры для функции disk_load:
-	mov bx, KERNEL_OFFSET	; Загрузим данные в место памяти
-							; смещению KERNEL_OFFSET
-	mov dh, 72				; Загрузим много секторов для ядра.
+	mov bx, KERNEL_OFFSET >> 4	; Загрузим данные в сегмент, который
+								; начинается с KERNEL_OFFSET
+	mov di, KERNEL_SECTORS	; Загрузим много секторов для ядра.
 	mov dl, [BOOT_DRIVE]	; Загрузим данные из BOOT_DRIVE (Возвращаем BOOT_DRIVE)
 	call disk_load			; Вызываем функцию disk_load
 	ret
@@ -47,6 +53,7 @@ load_kernel:
 BEGIN_PM:
 	mov ebx, MSG_PROT_MODE
 	call puts_chars_pm		; Печатаем сообщение об успешной загрузке в 32PM
+	mov ebx, E820_MAP		; Передаем ядру адрес карты памяти
 	call KERNEL_OFFSET		; Переходим в адрес, по которому загрузился код ядра
 	jmp $
 
@@ -4,19 +4,39 @@
 ; Description:
 ;	Чтобы лучше понять, что здесь происходит, разберитесь с тем, что такое CHS
 ;	по ссылке https://ru.wikipedia.org/wiki/CHS
+;
+;	Ядро читается по одному сектору за вызов: BIOS не обязан читать через
+;	границу дорожки и через границу 64К-сегмента за один вызов int 0x13,
+;	поэтому мы сами переходим на следующий сектор/головку/цилиндр и сдвигаем
+;	сегмент ES на 512 байт после каждого сектора. Так ядро может быть больше
+;	одной дорожки и больше 64 КБ.
 ; -----------------------------------------------------------------------------
 
+FLOPPY_SECTORS_PER_TRACK equ 18		; Геометрия 1.44 МБ дискеты
+FLOPPY_HEADS equ 2
+DISK_RETRIES equ 3
+
+; Вход:
+;	BX - сегмент, в который читаем (смещение 0)
+;	DI - количество секторов
+;	DL - номер диска
 disk_load:
-	push dx
-	mov ah, 0x02			; Указвыаем БИОСу что нам нужна рутина чтения диска
-							; Указываем что нам нужно:
-	mov al, dh				; 1. Прочитать кол-во секторов, равное значению в dh
-	mov ch, 0x00			; 2. Выбрать нулевой цилиндр
-	mov dh, 0x00			; 3. Выбрать нулевую головку
-	mov cl, 0x02			; 4. Начинать считывать со второго сектора (т.е.
-							; первый свободный сектор сразу после загруочного
-							; сектора, т.к. загрузочный сектор находится по
-							; адресу 0x01)
+	pusha
+	push es
+
+	mov es, bx				; ES:BX - адрес назначения
+	xor bx, bx
+	mov ch, 0x00			; Начинаем с нулевого цилиндра,
+	mov dh, 0x00			; нулевой головки
+	mov cl, 0x02			; и второго сектора (первый - загрузочный сектор)
+
+.next_sector:
+	mov si, DISK_RETRIES	; Дисковод может не успеть раскрутиться,
+							; поэтому даем BIOS несколько попыток
+
+.retry:
+	mov ah, 0x02			; Указываем БИОСу что нам нужна рутина чтения диска
+	mov al, 1				; Читаем ровно один сектор
 	int 0x13				; Вызываем прерывание для чтения
 
 							; У БИОСа может не получиться прочитать диск, и
@@ -25,18 +45,37 @@ disk_load:
 							; flag) специальным значением, которое означает
 							; ошибку, а во-вторых, кладет в регистр AL кол-во
 							; секторов, которые у него получилось прочитать.
+							; Мы читаем ровно один сектор, поэтому достаточно CF.
+	jnc .sector_read
+
+	dec si
+	jz disk_error			; Попытки закончились - сообщаем об ошибке
+	xor ah, ah				; Сбрасываем дисковод и пробуем снова
+	int 0x13
+	jmp .retry
 
-	jc disk_error			; jc - инструкция для прыжка на указанную метку,
-							; которая выполняется только если CF (carry flag)
-							; сигнализирует об ошибке
+.sector_read:
+	mov ax, es				; Следующий сектор кладем на 512 байт дальше
+	add ax, 0x20
+	mov es, ax
 
-	pop dx					; Восстанавливаем регистр DX из стека
-	cmp dh, al				; если AL (кол-во прочитанных секторов) != DH
-							; (предполагаемое кол-во секторов),
-	jne disk_sectors_error	; то выводим на экран сообщение об ошибке и зависаем
-							; (то есть запускаем бесконечный цикл)
+	inc cl					; Следующий сектор на дорожке
+	cmp cl, FLOPPY_SECTORS_PER_TRACK + 1
+	jne .advance
+	mov cl, 1				; Дорожка закончилась - переходим на другую головку
+	inc dh
+	cmp dh, FLOPPY_HEADS
+	jne .advance
+	mov dh, 0				; Обе головки прочитаны - следующий цилиндр
+	inc ch
+
+.advance:
+	dec di
+	jnz .next_sector
+
+	pop es
+	popa
 	jmp disk_success
-	jmp disk_exit			; Заканчиваем выполнение функции
 
 disk_success:
 	mov bx, SUCCESS_MSG
@@ -46,23 +85,16 @@ disk_success:
 disk_error:
 	mov bx, DISK_ERR_MSG	; Перемещаем в BX сообщение об ошибке
 	call puts_chars		    ; Выводим его на экран
-	mov dh, al
+	mov dh, ah				; Код ошибки BIOS
 	call puts_hex
 	jmp disk_loop			; бесконечный цикл
 
-disk_sectors_error:
-	mov bx, SECTORS_ERR_MSG
-	call puts_chars
-
 SUCCESS_MSG:
 	db "Success::Disk was read ", 0
 
 DISK_ERR_MSG:
 	db "DiskError::Disk read ", 0
 
-SECTORS_ERR_MSG:
-	db "SectorsError::Incorrect number of sectors read ", 0
-
 disk_loop:
 	jmp $
 
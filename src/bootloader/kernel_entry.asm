@@ -9,6 +9,8 @@
 [bits 32]
 [extern kmain]			; Определяем 'внешнюю' штуку с названием kmain - она понадобится
 						; линкеру чтобы собрать все вместе
+push ebx				; Загрузчик передает в EBX адрес карты памяти E820 -
+						; это аргумент kmain
 call kmain				; Вызываем определенную выше функцию, которая будет доступна
 						; после линковки. Это функция kmain из kernel.c
 jmp $
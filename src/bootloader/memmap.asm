@@ -0,0 +1,45 @@
+; ------------------------------------------------------------------------------
+;  Kintsugi OS Bootloader source code
+;  File: bootloader/memmap.asm
+;  Title: Получение карты памяти от BIOS (INT 15h, EAX=E820h)
+; Description:
+;	Каждый вызов INT 15h/E820 возвращает одну запись по 24 байта:
+;	база (8 байт), длина (8 байт), тип (4 байта), расширенные атрибуты ACPI
+;	(4 байта). EBX - номер следующей записи (0 - записей больше нет).
+;	Карта кладется по адресу E820_MAP: 2 байта - количество записей, 2 байта
+;	зарезервировано, дальше сами записи. Ядро получает этот адрес в EBX.
+; ------------------------------------------------------------------------------
+
+E820_MAP equ 0x0500			; Свободная память сразу после BIOS Data Area
+E820_MAX_ENTRIES equ 32
+E820_SMAP equ 0x534D4150	; "SMAP"
+
+[bits 16]
+
+; Регистры не сохраняются: после вызова загрузчик сразу переходит в PM.
+detect_memory_map:
+	push ds
+	pop es					; ES:DI - куда BIOS кладет очередную запись
+	mov di, E820_MAP + 4
+	xor ebx, ebx			; Начинаем с первой записи
+	xor si, si				; SI - количество записей
+
+.next_entry:
+	mov eax, 0xE820
+	mov ecx, 24
+	mov edx, E820_SMAP
+	int 0x15
+	jc .done				; CF - ошибка или конец списка
+	cmp eax, E820_SMAP		; BIOS без E820 не вернет "SMAP"
+	jne .done
+
+	inc si
+	add di, 24
+	cmp si, E820_MAX_ENTRIES
+	je .done
+	test ebx, ebx
+	jnz .next_entry
+
+.done:
+	mov [E820_MAP], si		; Количество записей (0, если E820 не поддерживается)
+	ret
@@ -0,0 +1,163 @@
+#include "apic.h"
+
+#include "../kklibc/math.h"
+#include "isr.h"
+#include "paging.h"
+#include "timer.h"
+
+#define CPUID_APIC (1 << 9)
+#define CPUID_TSC_DEADLINE (1 << 24)
+
+#define MSR_APIC_BASE 0x1B
+#define MSR_TSC_DEADLINE 0x6E0
+#define APIC_BASE_ENABLE 0x800
+#define APIC_BASE_MASK 0xFFFFF000
+
+/* Регистры локального APIC (смещения от базы) */
+#define APIC_TPR 0x080
+#define APIC_EOI 0x0B0
+#define APIC_SVR 0x0F0
+#define APIC_LVT_TIMER 0x320
+#define APIC_TIMER_INITIAL 0x380
+#define APIC_TIMER_CURRENT 0x390
+#define APIC_TIMER_DIVIDE 0x3E0
+
+#define APIC_SVR_ENABLE 0x100
+#define APIC_LVT_MASKED 0x10000
+#define APIC_LVT_ONESHOT 0x00000
+#define APIC_LVT_PERIODIC 0x20000
+#define APIC_LVT_TSC_DEADLINE 0x40000
+#define APIC_DIVIDE_16 0x3
+
+#define CALIBRATE_MS 10
+#define APIC_MAX_NS 1000000000ull    // дальше однократный отсчет не взводится: колесо будит раньше
+
+static volatile u32* apic_regs = NULL;
+static u32 apic_khz = 0;
+static u8 tsc_deadline = 0;
+static apic_timer_mode_t timer_mode = APIC_TIMER_OFF;
+
+static inline u32 apic_read(u32 reg) {
+    return apic_regs[reg / 4];
+}
+
+static inline void apic_write(u32 reg, u32 value) {
+    apic_regs[reg / 4] = value;
+}
+
+static inline u64 rdmsr(u32 msr) {
+    u32 low, high;
+    __asm__ volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((u64)high << 32) | low;
+}
+
+static inline void wrmsr(u32 msr, u64 value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((u32)value), "d"((u32)(value >> 32)) : "memory");
+}
+
+// такты счетчика APIC за CALIBRATE_MS, отмеренные по уже откалиброванному TSC
+static void calibrate() {
+    u64 wait = (u64)timer_tsc_khz() * CALIBRATE_MS;
+
+    apic_write(APIC_TIMER_DIVIDE, APIC_DIVIDE_16);
+    apic_write(APIC_LVT_TIMER, APIC_LVT_MASKED | APIC_TIMER_VECTOR);
+
+    u64 start = rdtsc();
+    apic_write(APIC_TIMER_INITIAL, 0xFFFFFFFF);
+    while (rdtsc() - start < wait) {
+    }
+    u32 elapsed = 0xFFFFFFFF - apic_read(APIC_TIMER_CURRENT);
+    apic_write(APIC_TIMER_INITIAL, 0);
+
+    apic_khz = elapsed / CALIBRATE_MS;
+}
+
+int apic_init() {
+    u32 eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if (!(edx & CPUID_APIC) || !timer_tsc_khz()) {
+        return 0;
+    }
+    tsc_deadline = (ecx & CPUID_TSC_DEADLINE) != 0;
+
+    u64 base = rdmsr(MSR_APIC_BASE);
+    u32 phys = (u32)base & APIC_BASE_MASK;
+    if (!paging_map_region(phys, PAGE_SIZE, PAGING_CACHE_UC)) {
+        return 0;
+    }
+    wrmsr(MSR_APIC_BASE, base | APIC_BASE_ENABLE);
+    apic_regs = (volatile u32*)phys;
+
+    apic_write(APIC_TPR, 0);
+    apic_write(APIC_SVR, APIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+
+    u32 flags = irq_save();
+    calibrate();
+    irq_restore(flags);
+
+    if (apic_khz == 0) {
+        apic_regs = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+void apic_eoi() {
+    apic_write(APIC_EOI, 0);
+}
+
+int apic_has_tsc_deadline() {
+    return tsc_deadline;
+}
+
+u32 apic_timer_khz() {
+    return apic_khz;
+}
+
+void apic_timer_periodic(u32 hz) {
+    apic_write(APIC_TIMER_DIVIDE, APIC_DIVIDE_16);
+    apic_write(APIC_LVT_TIMER, APIC_LVT_PERIODIC | APIC_TIMER_VECTOR);
+    apic_write(APIC_TIMER_INITIAL, apic_khz * 1000 / hz);
+    timer_mode = APIC_TIMER_PERIODIC;
+}
+
+void apic_timer_oneshot(u64 ns) {
+    if (ns > APIC_MAX_NS) {
+        ns = APIC_MAX_NS;
+    }
+
+    // ns * кГц / 10^6 с округлением вверх; при 1 с и 4 ГГц произведение меньше 2^64
+    u32 count = (u32)div64_u32(ns * apic_khz + NS_PER_MS - 1, NS_PER_MS, NULL);
+    if (count == 0) {
+        count = 1;
+    }
+
+    if (timer_mode != APIC_TIMER_ONESHOT) {
+        apic_write(APIC_TIMER_DIVIDE, APIC_DIVIDE_16);
+        apic_write(APIC_LVT_TIMER, APIC_LVT_ONESHOT | APIC_TIMER_VECTOR);
+        timer_mode = APIC_TIMER_ONESHOT;
+    }
+    apic_write(APIC_TIMER_INITIAL, count);
+}
+
+void apic_timer_deadline(u64 tsc) {
+    if (timer_mode != APIC_TIMER_TSC_DEADLINE) {
+        apic_write(APIC_LVT_TIMER, APIC_LVT_TSC_DEADLINE | APIC_TIMER_VECTOR);
+        // запись в LVT и запись в MSR должны идти по порядку (SDM 10.5.4.1)
+        __asm__ volatile("mfence" : : : "memory");
+        timer_mode = APIC_TIMER_TSC_DEADLINE;
+    }
+    wrmsr(MSR_TSC_DEADLINE, tsc ? tsc : 1);    // 0 снимает таймер
+}
+
+void apic_timer_stop() {
+    if (timer_mode == APIC_TIMER_TSC_DEADLINE) {
+        wrmsr(MSR_TSC_DEADLINE, 0);
+    } else if (timer_mode != APIC_TIMER_OFF) {
+        apic_write(APIC_TIMER_INITIAL, 0);
+    }
+}
+
+apic_timer_mode_t apic_timer_mode() {
+    return timer_mode;
+}
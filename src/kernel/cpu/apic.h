@@ -0,0 +1,83 @@
+#ifndef APIC_H
+#define APIC_H
+
+#include "../kklibc/ctypes.h"
+
+#define APIC_TIMER_VECTOR 48    // сразу за IRQ0-IRQ15 контроллера 8259
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+/**
+ * @brief Режим таймера локального APIC
+ *
+ **/
+typedef enum {
+    APIC_TIMER_OFF = 0,
+    APIC_TIMER_ONESHOT,    // счетчик шины, одно прерывание
+    APIC_TIMER_PERIODIC,    // счетчик шины, перезагрузка начальным значением
+    APIC_TIMER_TSC_DEADLINE,    // прерывание, когда TSC дойдет до значения в MSR
+} apic_timer_mode_t;
+
+/**
+ * @brief Включение локального APIC и калибровка его таймера по TSC
+ *
+ * Регистры отображаются страницей без кэширования, поэтому вызывается после
+ * paging_init. Режим виртуального провода, настроенный BIOS (LINT0 - ExtINT),
+ * не меняется: прерывания 8259 продолжают приходить как раньше.
+ *
+ * @return int 1 - таймер APIC готов к работе, 0 - APIC или TSC нет
+ **/
+int apic_init();
+
+/**
+ * @brief Конец обработки прерывания локального APIC
+ **/
+void apic_eoi();
+
+/**
+ * @brief Поддерживается ли режим TSC-deadline (CPUID.01H:ECX.TSC_DEADLINE)
+ *
+ * @return int 1 - да
+ **/
+int apic_has_tsc_deadline();
+
+/**
+ * @brief Частота счетчика таймера (шина после делителя)
+ *
+ * @return u32 кГц (0 - не откалиброван)
+ **/
+u32 apic_timer_khz();
+
+/**
+ * @brief Периодические прерывания таймера
+ *
+ * @param hz частота
+ **/
+void apic_timer_periodic(u32 hz);
+
+/**
+ * @brief Однократное прерывание через заданное время
+ *
+ * @param ns наносекунды (округляются вверх до такта счетчика)
+ **/
+void apic_timer_oneshot(u64 ns);
+
+/**
+ * @brief Прерывание в момент, когда TSC достигнет значения (режим TSC-deadline)
+ *
+ * @param tsc значение TSC
+ **/
+void apic_timer_deadline(u64 tsc);
+
+/**
+ * @brief Остановка таймера
+ **/
+void apic_timer_stop();
+
+/**
+ * @brief Текущий режим таймера
+ *
+ * @return apic_timer_mode_t
+ **/
+apic_timer_mode_t apic_timer_mode();
+
+#endif
@@ -0,0 +1,308 @@
+#include "clocksource.h"
+
+#include "../drivers/acpi.h"
+#include "../drivers/lowlevel_io.h"
+#include "../kklibc/function.h"
+#include "../kklibc/math.h"
+#include "../kklibc/stdio.h"
+#include "../kklibc/stdlib.h"
+#include "isr.h"
+#include "paging.h"
+#include "timer.h"
+
+#define CPUID_EXT_MAX 0x80000000
+#define CPUID_EXT_POWER 0x80000007
+#define CPUID_EXT_INVARIANT_TSC (1 << 8)
+
+#define PIT_CHANNEL2 0x42
+#define PIT_COMMAND 0x43
+#define PIT_GATE 0x61
+
+/* HPET: регистры блока таймеров */
+#define HPET_CAPABILITIES 0x00    // биты 63:32 - период счетчика в фемтосекундах
+#define HPET_CONFIG 0x10
+#define HPET_COUNTER 0xF0
+#define HPET_CAP_64BIT (1 << 13)
+#define HPET_CONFIG_ENABLE 0x1
+#define HPET_CONFIG_LEGACY 0x2    // замена PIT и RTC - не включаем, IRQ0 остается за PIT
+#define FS_PER_SEC 1000000000000000ull
+
+#define READ_COST_SAMPLES 64
+
+/**
+ * @brief Таблица ACPI "HPET"
+ *
+ **/
+typedef struct {
+    acpi_sdt_header_t header;
+    u32 event_timer_block_id;
+    u8 address_space;    // 0 - память
+    u8 register_width;
+    u8 register_offset;
+    u8 access_size;
+    u64 address;
+    u8 hpet_number;
+    u16 min_tick;
+    u8 page_protection;
+} __attribute__((packed)) acpi_hpet_t;
+
+static clocksource_t sources[CLOCKSOURCE_MAX];
+static u32 source_count = 0;
+
+/* Состояние часов под seqlock: нечетный clock_seq - идет обновление.
+ * Писатели (смена источника, периодическое обновление) работают при запрещенных прерываниях,
+ * поэтому на одном процессоре читатель в обработчике IRQ не застает нечетный счетчик. */
+static volatile u32 clock_seq = 0;
+static clocksource_t* current = NULL;
+static u64 cycle_last = 0;
+static u64 ns_base = 0;
+
+static ktimer_t update_timer;
+static volatile u32* hpet_regs = NULL;
+static u8 hpet_counter_64 = 0;
+
+#define barrier() __asm__ volatile("" : : : "memory")
+
+static u64 tsc_read() {
+    return rdtsc();
+}
+
+// 64-битный счетчик HPET читается половинами: старшую половину сверяем до и после
+static u64 hpet_read() {
+    if (!hpet_counter_64) {
+        return hpet_regs[HPET_COUNTER / 4];
+    }
+
+    u32 high, low;
+    do {
+        high = hpet_regs[HPET_COUNTER / 4 + 1];
+        low = hpet_regs[HPET_COUNTER / 4];
+    } while (high != hpet_regs[HPET_COUNTER / 4 + 1]);
+    return ((u64)high << 32) | low;
+}
+
+// канал 2 PIT в режиме 2 считает вниз от 65536; инвертируем, чтобы счетчик рос
+static u64 pit_read() {
+    u32 flags = irq_save();
+    port_byte_out(PIT_COMMAND, 0x80); /* защелка канала 2 */
+    u32 low = port_byte_in(PIT_CHANNEL2);
+    u32 high = port_byte_in(PIT_CHANNEL2);
+    irq_restore(flags);
+
+    return (0x10000 - ((high << 8) | low)) & 0xFFFF;
+}
+
+static u64 cycles_to_ns(const clocksource_t* cs, u64 cycles) {
+    // 64 x 32 бит: младшая и старшая половины умножаются отдельно
+    u64 low = (u64)(u32)cycles * cs->mult;
+    u64 high = (u64)(u32)(cycles >> 32) * cs->mult;
+
+    return (low >> cs->shift) + (high << (32 - cs->shift));
+}
+
+static void clocksource_register(const char* name, u32 rating, u64 (*read)(), u64 mask, u64 freq_hz) {
+    if (source_count == CLOCKSOURCE_MAX || freq_hz == 0) {
+        return;
+    }
+
+    clocksource_t* cs = &sources[source_count++];
+    cs->name = name;
+    cs->rating = rating;
+    cs->read = read;
+    cs->mask = mask;
+    cs->freq_hz = freq_hz;
+
+    // наибольший множитель, который помещается в 32 бита
+    cs->shift = 32;
+    while (udivmod64(NS_PER_SEC << cs->shift, freq_hz, NULL) > 0xFFFFFFFF) {
+        cs->shift--;
+    }
+    cs->mult = (u32)udivmod64(NS_PER_SEC << cs->shift, freq_hz, NULL);
+    cs->max_idle_ns = (mask >> 63) ? 0 : cycles_to_ns(cs, mask >> 1);
+    cs->read_cycles = 0;
+}
+
+u64 clock_now_ns() {
+    u32 seq;
+    u64 ns;
+
+    do {
+        seq = clock_seq;
+        barrier();
+
+        if (!current) {
+            return 0;
+        }
+        ns = ns_base + cycles_to_ns(current, (current->read() - cycle_last) & current->mask);
+
+        barrier();
+    } while (seq != clock_seq);
+
+    return ns;
+}
+
+// перенос накопленного времени в ns_base: счетчик не успевает пройти полный оборот
+static void clock_update_locked() {
+    u64 now = current->read();
+
+    clock_seq++;
+    barrier();
+    ns_base += cycles_to_ns(current, (now - cycle_last) & current->mask);
+    cycle_last = now;
+    barrier();
+    clock_seq++;
+}
+
+static void clock_update_timer(void* data) {
+    UNUSED(data);
+    clock_update_locked();
+    timer_add(&update_timer, clock_now_ns() + current->max_idle_ns, clock_update_timer, NULL);
+}
+
+int clocksource_select(const char* name) {
+    clocksource_t* best = NULL;
+
+    for (u32 i = 0; i < source_count; i++) {
+        clocksource_t* cs = &sources[i];
+        int match = name ? strcmp((char*)cs->name, (char*)name) == 0 : (!best || cs->rating > best->rating);
+        if (match) {
+            best = cs;
+        }
+    }
+    if (!best) {
+        return 0;
+    }
+
+    u32 flags = irq_save();
+
+    // время продолжается с того же значения: показание старого источника становится базой
+    u64 now = clock_now_ns();
+    clock_seq++;
+    barrier();
+    current = best;
+    cycle_last = best->read();
+    ns_base = now;
+    barrier();
+    clock_seq++;
+
+    timer_cancel(&update_timer);
+    if (best->max_idle_ns) {
+        timer_add(&update_timer, now + best->max_idle_ns, clock_update_timer, NULL);
+    }
+
+    irq_restore(flags);
+    return 1;
+}
+
+const clocksource_t* clocksource_current() {
+    return current;
+}
+
+void clocksource_init_early(u32 tsc_khz) {
+    // канал 2 PIT: режим 2, полный оборот 65536, вход GATE открыт, динамик выключен
+    port_byte_out(PIT_GATE, (port_byte_in(PIT_GATE) & ~0x02) | 0x01);
+    port_byte_out(PIT_COMMAND, 0xB4);
+    port_byte_out(PIT_CHANNEL2, 0);
+    port_byte_out(PIT_CHANNEL2, 0);
+    clocksource_register("pit", CLOCKSOURCE_RATING_PIT, pit_read, 0xFFFF, PIT_FREQUENCY);
+
+    if (tsc_khz) {
+        u32 eax, ebx, ecx, edx;
+        u32 rating = CLOCKSOURCE_RATING_TSC;
+
+        __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(CPUID_EXT_MAX));
+        if (eax >= CPUID_EXT_POWER) {
+            __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(CPUID_EXT_POWER));
+            if (edx & CPUID_EXT_INVARIANT_TSC) {
+                rating = CLOCKSOURCE_RATING_TSC_INVARIANT;
+            }
+        }
+        clocksource_register("tsc", rating, tsc_read, 0xFFFFFFFFFFFFFFFFull, (u64)tsc_khz * 1000);
+    }
+
+    clocksource_select(NULL);
+}
+
+static void hpet_probe() {
+    const acpi_hpet_t* table = (const acpi_hpet_t*)acpi_find_table("HPET");
+    if (!table || table->address_space != 0 || table->address == 0 || (table->address >> 32)) {
+        return;
+    }
+
+    u32 base = (u32)table->address;
+    if (!paging_map_region(base, PAGE_SIZE, PAGING_CACHE_UC)) {
+        return;
+    }
+    hpet_regs = (volatile u32*)base;
+
+    u32 period_fs = hpet_regs[HPET_CAPABILITIES / 4 + 1];
+    if (period_fs == 0 || period_fs > 100000000) {    // по спецификации не больше 100 нс
+        hpet_regs = NULL;
+        return;
+    }
+    hpet_counter_64 = (hpet_regs[HPET_CAPABILITIES / 4] & HPET_CAP_64BIT) != 0;
+
+    u32 config = hpet_regs[HPET_CONFIG / 4];
+    hpet_regs[HPET_CONFIG / 4] = (config & ~HPET_CONFIG_LEGACY) | HPET_CONFIG_ENABLE;
+
+    clocksource_register(
+        "hpet",
+        CLOCKSOURCE_RATING_HPET,
+        hpet_read,
+        hpet_counter_64 ? 0xFFFFFFFFFFFFFFFFull : 0xFFFFFFFF,
+        udivmod64(FS_PER_SEC, period_fs, NULL));
+}
+
+// цена чтения: READ_COST_SAMPLES вызовов подряд по TSC
+static void measure_read_cost(clocksource_t* cs) {
+    if (!timer_tsc_khz()) {
+        return;
+    }
+
+    u32 flags = irq_save();
+    u64 start = rdtsc();
+    for (u32 i = 0; i < READ_COST_SAMPLES; i++) {
+        cs->read();
+    }
+    cs->read_cycles = (u32)((rdtsc() - start) / READ_COST_SAMPLES);
+    irq_restore(flags);
+}
+
+void clocksource_init() {
+    hpet_probe();
+
+    for (u32 i = 0; i < source_count; i++) {
+        measure_read_cost(&sources[i]);
+    }
+    clocksource_select(NULL);
+
+    printf("Clocksource: %s", current->name);
+    if (hpet_regs) {
+        u32 hpet_khz = (u32)div64_u32(sources[source_count - 1].freq_hz, 1000, NULL);
+        printf(" (HPET %u kHz found via ACPI)", hpet_khz);
+    }
+    printf("\n");
+}
+
+void clocksource_dump() {
+    printf("  %-6s %6s %10s %14s %18s\n", "name", "rating", "freq kHz", "resolution", "read cost");
+
+    for (u32 i = 0; i < source_count; i++) {
+        clocksource_t* cs = &sources[i];
+        u32 resolution_ps = (u32)udivmod64(1000000000000ull, cs->freq_hz, NULL);    // период счетчика
+
+        printf(
+            "%c %-6s %6u %10u %7u.%03u ns",
+            cs == current ? '*' : ' ',
+            cs->name,
+            cs->rating,
+            (u32)div64_u32(cs->freq_hz, 1000, NULL),
+            resolution_ps / 1000,
+            resolution_ps % 1000);
+        if (cs->read_cycles) {
+            printf(" %6u cyc %5u ns\n", cs->read_cycles, (u32)timer_cycles_to_ns(cs->read_cycles));
+        } else {
+            printf(" %18s\n", "-");
+        }
+    }
+}
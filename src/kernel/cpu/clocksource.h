@@ -0,0 +1,76 @@
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include "../kklibc/ctypes.h"
+
+#define CLOCKSOURCE_MAX 4
+
+/* Рейтинги источников: при загрузке выбирается источник с наибольшим */
+#define CLOCKSOURCE_RATING_TSC_INVARIANT 300    // частота не зависит от P/C-состояний
+#define CLOCKSOURCE_RATING_HPET 250
+#define CLOCKSOURCE_RATING_TSC 150    // TSC без CPUID.80000007H:EDX.InvariantTSC
+#define CLOCKSOURCE_RATING_PIT 50
+
+/**
+ * @brief Источник времени: свободно бегущий счетчик с известной частотой
+ *
+ **/
+typedef struct clocksource {
+    const char* name;
+    u32 rating;
+    u64 (*read)();
+    u64 mask;    // разрядность счетчика: разность показаний берется по маске
+    u64 freq_hz;
+    u32 mult;    // ns = cycles * mult >> shift
+    u32 shift;
+    u64 max_idle_ns;    // за это время счетчик проходит половину оборота (0 - 64 бита, переполнения нет)
+    u32 read_cycles;    // цена одного чтения в тактах TSC (0 - не измерялась)
+} clocksource_t;
+
+/**
+ * @brief Регистрация TSC и канала 2 PIT и выбор лучшего из них
+ *
+ * Вызывается из init_timer после калибровки TSC.
+ *
+ * @param tsc_khz частота TSC (0 - TSC нет)
+ **/
+void clocksource_init_early(u32 tsc_khz);
+
+/**
+ * @brief Поиск HPET через таблицу ACPI, измерение цены чтения и выбор лучшего источника
+ *
+ * Вызывается после paging_init: регистры HPET и таблицы ACPI отображаются в память.
+ **/
+void clocksource_init();
+
+/**
+ * @brief Монотонное время по текущему источнику
+ *
+ * Чтение без блокировок: состояние (источник, последнее показание, накопленное время)
+ * защищено seqlock, читатель повторяет попытку, если его прервало обновление.
+ *
+ * @return u64 наносекунды с момента init_timer
+ **/
+u64 clock_now_ns();
+
+/**
+ * @brief Смена источника времени без скачка показаний
+ *
+ * @param name имя источника (NULL - с наибольшим рейтингом)
+ * @return int 1 - источник выбран, 0 - не найден
+ **/
+int clocksource_select(const char* name);
+
+/**
+ * @brief Текущий источник времени
+ *
+ * @return const clocksource_t*
+ **/
+const clocksource_t* clocksource_current();
+
+/**
+ * @brief Вывод списка источников: рейтинг, частота, разрешение, цена чтения
+ **/
+void clocksource_dump();
+
+#endif
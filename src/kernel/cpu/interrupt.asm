@@ -1,6 +1,9 @@
 ; Defined in isr.c
 [extern isr_handler]
 [extern irq_handler]
+[extern irq_handler_fast]
+; Defined in bench.c
+[extern bench_irq_legacy]
 
 ; Common ISR code
 isr_common_stub:
@@ -8,21 +11,30 @@ isr_common_stub:
 	pusha ; Pushes edi,esi,ebp,esp,ebx,edx,ecx,eax
 	mov ax, ds ; Lower 16-bits of eax = ds.
 	push eax ; save the data segment descriptor
+	cmp ax, 0x10 ; segment loads are slow: skip them if ds already holds the kernel data segment
+	je .kernel_ds
 	mov ax, 0x10  ; kernel data segment descriptor
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
 	mov gs, ax
+.kernel_ds:
 
     ; 2. Call C handler
+	cld ; C code expects DF = 0 (it may have interrupted memmove)
+	push esp ; registers_t* - the frame is passed in place, not copied
 	call isr_handler
+	add esp, 4
 
     ; 3. Restore state
 	pop eax
+	cmp ax, 0x10
+	je .restored
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
 	mov gs, ax
+.restored:
 	popa
 	add esp, 8 ; Cleans up the pushed error code and pushed ISR number
 	sti
@@ -34,22 +46,73 @@ irq_common_stub:
     pusha
     mov ax, ds
     push eax
+    cmp ax, 0x10
+    je .kernel_ds
     mov ax, 0x10
     mov ds, ax
     mov es, ax
     mov fs, ax
     mov gs, ax
+.kernel_ds:
+    cld
+    push esp
     call irq_handler ; Different than the ISR code
+    add esp, 4
     pop ebx  ; Different than the ISR code
+    cmp bx, 0x10
+    je .restored
     mov ds, bx
     mov es, bx
     mov fs, bx
     mov gs, bx
+.restored:
     popa
     add esp, 8
     sti
     iret
 
+; Fast IRQ path for handlers that don't look at the register frame.
+; Only eax, ecx and edx are saved: the C handler preserves the rest itself.
+; The stub pushes just the vector number, irq_handler_fast gets it as argument.
+irq_fast_common:
+    push eax
+    push ecx
+    push edx
+    mov ax, ds
+    push eax
+    cmp ax, 0x10
+    je .kernel_ds
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+.kernel_ds:
+    cld
+    push dword [esp + 16] ; vector number pushed by the stub
+    call irq_handler_fast
+    add esp, 4
+    pop eax
+    cmp ax, 0x10
+    je .restored
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+.restored:
+    pop edx
+    pop ecx
+    pop eax
+    add esp, 4 ; vector number
+    iret
+
+%macro IRQ_FAST 2
+global %1
+%1:
+    push byte %2
+    jmp irq_fast_common
+%endmacro
+
 ; We don't get information about which interrupt was caller
 ; when the handler is run, so we will need to have a different handler
 ; for every interrupt.
@@ -107,6 +170,8 @@ global irq12
 global irq13
 global irq14
 global irq15
+global irq_apic_timer
+global irq_apic_spurious
 
 ; 0: Divide By Zero Exception
 isr0:
@@ -422,3 +487,77 @@ irq15:
 	push byte 15
 	push byte 47
 	jmp irq_common_stub
+
+; Local APIC: timer (vector 48) and spurious interrupt (vector 255, no EOI needed)
+irq_apic_timer:
+	cli
+	push byte 0
+	push byte 48
+	jmp irq_common_stub
+
+irq_apic_spurious:
+	iret
+
+; Fast path stubs (vectors 32-48), see irq_fast_common
+IRQ_FAST irq0_fast, 32
+IRQ_FAST irq1_fast, 33
+IRQ_FAST irq2_fast, 34
+IRQ_FAST irq3_fast, 35
+IRQ_FAST irq4_fast, 36
+IRQ_FAST irq5_fast, 37
+IRQ_FAST irq6_fast, 38
+IRQ_FAST irq7_fast, 39
+IRQ_FAST irq8_fast, 40
+IRQ_FAST irq9_fast, 41
+IRQ_FAST irq10_fast, 42
+IRQ_FAST irq11_fast, 43
+IRQ_FAST irq12_fast, 44
+IRQ_FAST irq13_fast, 45
+IRQ_FAST irq14_fast, 46
+IRQ_FAST irq15_fast, 47
+IRQ_FAST irq_apic_timer_fast, 48
+
+; Fast stub addresses indexed by vector - 32, used by register_interrupt_handler_fast
+global irq_fast_stubs
+irq_fast_stubs:
+	dd irq0_fast, irq1_fast, irq2_fast, irq3_fast, irq4_fast, irq5_fast, irq6_fast, irq7_fast
+	dd irq8_fast, irq9_fast, irq10_fast, irq11_fast, irq12_fast, irq13_fast, irq14_fast, irq15_fast
+	dd irq_apic_timer_fast
+
+; Benchmark vector 49 (bench irq): the same handler through the full frame,
+; the fast path and the previous entry code
+global irq_bench_frame
+irq_bench_frame:
+	cli
+	push byte 0
+	push byte 49
+	jmp irq_common_stub
+
+IRQ_FAST irq_bench_fast, 49
+
+; Previous IRQ entry: segment registers are always reloaded and
+; bench_irq_legacy takes registers_t by value
+global irq_bench_legacy
+irq_bench_legacy:
+	cli
+	push byte 0
+	push byte 49
+	pusha
+	mov ax, ds
+	push eax
+	mov ax, 0x10
+	mov ds, ax
+	mov es, ax
+	mov fs, ax
+	mov gs, ax
+	cld
+	call bench_irq_legacy
+	pop ebx
+	mov ds, bx
+	mov es, bx
+	mov fs, bx
+	mov gs, bx
+	popa
+	add esp, 8
+	sti
+	iret
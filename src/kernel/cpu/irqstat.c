@@ -0,0 +1,179 @@
+#include "irqstat.h"
+
+#include "../kklibc/math.h"
+#include "../kklibc/stdio.h"
+#include "../kklibc/stdlib.h"
+#include "apic.h"
+#include "isr.h"
+#include "timer.h"
+
+#define NO_VECTOR 0xFFFFFFFF
+
+static irqstat_t stats[IRQSTAT_VECTORS];
+static u8 enabled = 0;
+
+/* Текущее окно без прерываний и самое долгое из закрытых */
+static u64 irqoff_since = 0;    // 0 - прерывания разрешены или замеры выключены
+static u32 irqoff_vector = NO_VECTOR;    // вектор, с входа в который началось окно
+static u64 irqoff_max = 0;
+static u32 irqoff_max_site = 0;
+static u32 irqoff_max_vector = NO_VECTOR;
+
+static u32 log2_bucket(u32 cycles) {
+    if (cycles < 2) {
+        return 0;
+    }
+
+    u32 index;
+    __asm__("bsr %1, %0" : "=r"(index) : "rm"(cycles));
+    return index < IRQSTAT_BUCKETS ? index : IRQSTAT_BUCKETS - 1;
+}
+
+static void irqoff_stop(u32 site) {
+    if (!irqoff_since) {
+        return;
+    }
+
+    u64 cycles = rdtsc() - irqoff_since;
+    if (cycles > irqoff_max) {
+        irqoff_max = cycles;
+        irqoff_max_site = site;
+        irqoff_max_vector = irqoff_vector;
+    }
+    irqoff_since = 0;
+}
+
+void irqstat_enable() {
+    irqstat_reset();
+    enabled = 1;
+}
+
+u64 irqstat_enter(u32 vector) {
+    if (!enabled) {
+        return 0;
+    }
+
+    u64 now = rdtsc();
+    if (!irqoff_since) {
+        irqoff_since = now;
+        irqoff_vector = vector;
+    }
+    return now;
+}
+
+void irqstat_account(u32 vector, u64 start) {
+    if (vector >= IRQSTAT_VECTORS) {
+        return;
+    }
+
+    irqstat_t* stat = &stats[vector];
+    stat->count++;
+    if (!start) {
+        return;
+    }
+
+    u64 elapsed = rdtsc() - start;
+    u32 cycles = elapsed > 0xFFFFFFFF ? 0xFFFFFFFF : (u32)elapsed;
+
+    stat->total_cycles += cycles;
+    if (stat->count == 1 || cycles < stat->min_cycles) {
+        stat->min_cycles = cycles;
+    }
+    if (cycles > stat->max_cycles) {
+        stat->max_cycles = cycles;
+    }
+    stat->hist[log2_bucket(cycles)]++;
+}
+
+void irqstat_irqs_off() {
+    if (enabled && !irqoff_since) {
+        irqoff_since = rdtsc();
+        irqoff_vector = NO_VECTOR;
+    }
+}
+
+void irqstat_irqs_on() {
+    if (enabled) {
+        irqoff_stop((u32)__builtin_return_address(0));
+    }
+}
+
+void irqstat_reset() {
+    u32 flags = irq_save();
+
+    memset(stats, 0, sizeof(stats));
+    irqoff_max = 0;
+    irqoff_max_site = 0;
+    irqoff_max_vector = NO_VECTOR;
+
+    irq_restore(flags);
+}
+
+static const char* vector_name(u32 vector) {
+    if (vector < 32) {
+        return exception_messages[vector];
+    }
+
+    switch (vector) {
+        case IRQ0:
+            return "PIT timer";
+        case IRQ1:
+            return "keyboard";
+        case IRQ14:
+            return "primary ATA";
+        case IRQ15:
+            return "secondary ATA";
+        case APIC_TIMER_VECTOR:
+            return "APIC timer";
+        case IRQ_BENCH_VECTOR:
+            return "bench irq";
+        default:
+            return "IRQ";
+    }
+}
+
+void irqstat_dump() {
+    printf("%-6s %-16s %10s %10s %10s %10s\n", "vector", "name", "count", "min", "avg", "max");
+
+    for (u32 vector = 0; vector < IRQSTAT_VECTORS; vector++) {
+        irqstat_t* stat = &stats[vector];
+        if (!stat->count) {
+            continue;
+        }
+
+        printf(
+            "%6u %-16s %10u %10u %10llu %10u\n",
+            vector,
+            vector_name(vector),
+            stat->count,
+            stat->min_cycles,
+            div64_u32(stat->total_cycles, stat->count, NULL),
+            stat->max_cycles);
+
+        // гистограмма: только непустые корзины, "2^k:n"
+        u32 printed = 0;
+        for (u32 i = 0; i < IRQSTAT_BUCKETS; i++) {
+            if (stat->hist[i]) {
+                printf("%s2^%u:%u", printed++ ? " " : "       cycles ", i, stat->hist[i]);
+            }
+        }
+        if (printed) {
+            kprint("\n");
+        }
+    }
+
+    if (!enabled) {
+        kprint("No TSC: handler time and irq-off windows are not measured\n");
+        return;
+    }
+
+    printf(
+        "Longest irq-off window: %llu cycles (%llu ns), closed at 0x%x",
+        irqoff_max,
+        timer_cycles_to_ns(irqoff_max),
+        irqoff_max_site);
+    if (irqoff_max_vector != NO_VECTOR) {
+        printf(", opened by vector %u (%s)", irqoff_max_vector, vector_name(irqoff_max_vector));
+    }
+    kprint("\n");
+}
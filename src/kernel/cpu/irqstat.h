@@ -0,0 +1,69 @@
+#ifndef IRQSTAT_H
+#define IRQSTAT_H
+
+#include "../kklibc/ctypes.h"
+
+#define IRQSTAT_VECTORS 64    // исключения, IRQ 8259 и таймер APIC (вектор 48)
+#define IRQSTAT_BUCKETS 24    // корзина k - от 2^k до 2^(k+1) тактов, последняя - все, что дольше
+
+/**
+ * @brief Статистика одного вектора прерывания. Время - в тактах TSC
+ *
+ **/
+typedef struct irqstat {
+    u32 count;
+    u64 total_cycles;
+    u32 min_cycles;
+    u32 max_cycles;
+    u32 hist[IRQSTAT_BUCKETS];    // log2 времени обработчика
+} irqstat_t;
+
+/**
+ * @brief Включение замеров. Вызывается после калибровки TSC: без TSC считаются только вызовы
+ *
+ **/
+void irqstat_enable();
+
+/**
+ * @brief Вход в обработчик прерывания: вентиль IDT уже запретил прерывания,
+ * с этого момента идет окно без прерываний
+ *
+ * @param vector номер вектора
+ * @return u64 TSC входа для irqstat_account (0 - замеры выключены)
+ **/
+u64 irqstat_enter(u32 vector);
+
+/**
+ * @brief Учет вызова обработчика вектора
+ *
+ * @param vector номер вектора
+ * @param start значение irqstat_enter
+ **/
+void irqstat_account(u32 vector, u64 start);
+
+/**
+ * @brief Начало окна с запрещенными прерываниями
+ *
+ **/
+void irqstat_irqs_off();
+
+/**
+ * @brief Конец окна с запрещенными прерываниями (перед sti, popf или iret).
+ * Местом окна считается адрес возврата в вызывающий код
+ *
+ **/
+void irqstat_irqs_on();
+
+/**
+ * @brief Сброс счетчиков и самого долгого окна
+ *
+ **/
+void irqstat_reset();
+
+/**
+ * @brief Вывод статистики по векторам, гистограмм и самого долгого окна без прерываний
+ *
+ **/
+void irqstat_dump();
+
+#endif
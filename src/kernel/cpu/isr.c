@@ -3,12 +3,16 @@
 #include "../drivers/keyboard.h"
 #include "../drivers/lowlevel_io.h"
 #include "../drivers/screen.h"
+#include "../drivers/terminal.h"
 #include "../kklibc/stdio.h"
 #include "../kklibc/stdlib.h"
+#include "apic.h"
 #include "idt.h"
+#include "softirq.h"
 #include "timer.h"
 
 isr_t interrupt_handlers[256];
+volatile u32 irq_nesting = 0;
 
 /* Мы не можем сделать это с помощью цикла, потому
  * что нам нужен адрес имен функций */
@@ -75,6 +79,8 @@ void isr_install() {
     set_idt_gate(45, (u32)irq13);
     set_idt_gate(46, (u32)irq14);
     set_idt_gate(47, (u32)irq15);
+    set_idt_gate(APIC_TIMER_VECTOR, (u32)irq_apic_timer);
+    set_idt_gate(APIC_SPURIOUS_VECTOR, (u32)irq_apic_spurious);
 
     set_idt();    // Загрузка через ассембер
 }
@@ -116,20 +122,24 @@ char* exception_messages[] = { "Division By Zero",
                                "Reserved",
                                "Reserved" };
 
-void isr_handler(registers_t r) {
+void isr_handler(registers_t* r) {
+    irqstat_account(r->int_no, 0);
+
     kprint("Received interrupt: ");
     char s[3];
-    int_to_ascii(r.int_no, s);
+    int_to_ascii(r->int_no, s);
 
     kprint(s);
     kprint("\n");
-    kprint(exception_messages[r.int_no]);
+    kprint(exception_messages[r->int_no]);
     kprint("\n");
 
-    if (interrupt_handlers[r.int_no]) {
-        interrupt_handlers[r.int_no](r);
+    if (interrupt_handlers[r->int_no]) {
+        interrupt_handlers[r->int_no](r);
     }
 
+    terminal_flush();    // исключение внутри команды шелла: вывод мог быть отложен
+
     __asm__ volatile("hlt");
 }
 
@@ -137,19 +147,52 @@ void register_interrupt_handler(u8 n, isr_t handler) {
     interrupt_handlers[n] = handler;
 }
 
-void irq_handler(registers_t r) {
+void register_interrupt_handler_fast(u8 n, isr_t handler) {
+    interrupt_handlers[n] = handler;
+
+    if (n >= IRQ0 && n < IRQ0 + IRQ_FAST_COUNT) {
+        set_idt_gate(n, irq_fast_stubs[n - IRQ0]);
+    }
+}
+
+/* Общая часть полного и быстрого пути, r == NULL на быстром */
+static inline void irq_dispatch(u32 vector, registers_t* r) {
+    u64 start = irqstat_enter(vector);
+
     /* После каждого прерывания нам нужно отправлять EOI на PICs,
      * иначе они больше не отправят другое прерывание */
-    if (r.int_no >= 40) {
-        port_byte_out(0xA0, 0x20); /* slave */
+    if (vector == APIC_TIMER_VECTOR) {
+        apic_eoi(); /* таймер APIC идет мимо 8259 */
+    } else if (vector <= IRQ15) {
+        if (vector >= IRQ8) {
+            port_byte_out(0xA0, 0x20); /* slave */
+        }
+        port_byte_out(0x20, 0x20); /* master */
     }
-    port_byte_out(0x20, 0x20); /* master */
 
     /* Обрабатывание прерывание более модульным способом */
-    if (interrupt_handlers[r.int_no] != 0) {
-        isr_t handler = interrupt_handlers[r.int_no];
+    if (interrupt_handlers[vector] != 0) {
+        isr_t handler = interrupt_handlers[vector];
+        irq_nesting++;
         handler(r);
+        irq_nesting--;
     }
+    irqstat_account(vector, start);
+
+    /* Отложенная работа обработчиков - уже с разрешенными прерываниями */
+    if (irq_nesting == 0) {
+        softirq_run();
+    }
+
+    irqstat_irqs_on(); /* iret вернет прерывания */
+}
+
+void irq_handler(registers_t* r) {
+    irq_dispatch(r->int_no, r);
+}
+
+void irq_handler_fast(u32 vector) {
+    irq_dispatch(vector, NULL);
 }
 
 void irq_install() {
@@ -157,7 +200,7 @@ void irq_install() {
     __asm__ volatile("sti");
 
     /* IRQ0: таймер */
-    init_timer(50);
+    init_timer(TIMER_HZ);
 
     /* IRQ1: клавиатура */
     init_keyboard();
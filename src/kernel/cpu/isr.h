@@ -2,6 +2,7 @@
 #define ISR_H
 
 #include "../kklibc/ctypes.h"
+#include "irqstat.h"
 
 /* ISR зарезервированы для исключений процессора */
 extern void isr0();
@@ -52,6 +53,12 @@ extern void irq12();
 extern void irq13();
 extern void irq14();
 extern void irq15();
+extern void irq_apic_timer();
+extern void irq_apic_spurious();
+extern void irq_bench_frame();
+extern void irq_bench_fast();
+extern void irq_bench_legacy();
+extern u32 irq_fast_stubs[];    // короткие заглушки векторов 32-48, индекс - вектор минус IRQ0
 
 #define IRQ0 32
 #define IRQ1 33
@@ -69,6 +76,8 @@ extern void irq15();
 #define IRQ13 45
 #define IRQ14 46
 #define IRQ15 47
+#define IRQ_FAST_COUNT 17    // IRQ0-IRQ15 и таймер APIC (вектор 48)
+#define IRQ_BENCH_VECTOR 49    // вектор для bench irq, вызывается программно через int
 
 /* Структура для аггрегации регистров */
 typedef struct {
@@ -84,12 +93,28 @@ typedef struct {
  **/
 void isr_install();
 
+extern char* exception_messages[];    // названия исключений 0-31
+
 /**
  * @brief Обработчик ISR
  *
- * @param r регистры
+ * @param r регистры (кадр на стеке заглушки)
+ **/
+void isr_handler(registers_t* r);
+
+/**
+ * @brief Обработчик IRQ с полным кадром регистров
+ *
+ * @param r регистры (кадр на стеке заглушки)
  **/
-void isr_handler(registers_t r);
+void irq_handler(registers_t* r);
+
+/**
+ * @brief Обработчик IRQ быстрого пути: заглушка сохраняет только eax, ecx, edx
+ *
+ * @param vector номер вектора
+ **/
+void irq_handler_fast(u32 vector);
 
 /**
  * @brief установка IRQ
@@ -97,7 +122,7 @@ void isr_handler(registers_t r);
  **/
 void irq_install();
 
-typedef void (*isr_t)(registers_t);
+typedef void (*isr_t)(registers_t*);
 
 /**
  * @brief Регистрация обработчика прерывания
@@ -107,4 +132,55 @@ typedef void (*isr_t)(registers_t);
  **/
 void register_interrupt_handler(u8 n, isr_t handler);
 
+/**
+ * @brief Регистрация обработчика IRQ, которому не нужны регистры прерванного кода
+ *
+ * Вектор переводится на быструю заглушку: она не сохраняет полный кадр,
+ * обработчик получает r == NULL. Для векторов вне IRQ0-IRQ15 и таймера APIC
+ * работает как register_interrupt_handler.
+ *
+ * @param n номер прерывания
+ * @param handler обработчик
+ **/
+void register_interrupt_handler_fast(u8 n, isr_t handler);
+
+extern volatile u32 irq_nesting;    // глубина вложенности irq_handler (0 - вне обработчика IRQ)
+
+/**
+ * @brief Выполняется ли код внутри обработчика IRQ
+ *
+ * @return int 1 - да
+ **/
+static inline int in_interrupt() {
+    return irq_nesting != 0;
+}
+
+#define EFLAGS_IF 0x200    // флаг разрешения прерываний
+
+/**
+ * @brief Запрет прерываний с сохранением прежнего состояния EFLAGS.IF
+ *
+ * @return u32 EFLAGS для irq_restore
+ **/
+static inline u32 irq_save() {
+    u32 flags;
+    __asm__ volatile("pushf; pop %0; cli" : "=r"(flags) : : "memory");
+    if (flags & EFLAGS_IF) {
+        irqstat_irqs_off();
+    }
+    return flags;
+}
+
+/**
+ * @brief Восстановление состояния прерываний, сохраненного irq_save
+ *
+ * @param flags EFLAGS
+ **/
+static inline void irq_restore(u32 flags) {
+    if (flags & EFLAGS_IF) {
+        irqstat_irqs_on();
+    }
+    __asm__ volatile("push %0; popf" : : "r"(flags) : "memory", "cc");
+}
+
 #endif
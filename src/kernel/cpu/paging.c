@@ -0,0 +1,261 @@
+#include "paging.h"
+
+#include "../drivers/screen.h"
+#include "../kklibc/mem.h"
+#include "../kklibc/pmm.h"
+#include "../kklibc/stdio.h"
+#include "../kklibc/stdlib.h"
+#include "isr.h"
+
+#define CPUID_PSE (1 << 3)
+#define CPUID_PGE (1 << 13)
+#define CPUID_PAT (1 << 16)
+
+#define CR0_PG 0x80000000
+#define CR4_PSE 0x10
+#define CR4_PGE 0x80
+
+/* PAT: PA0-PA3 оставляем как после сброса (WB, WT, UC-, UC), PA4 делаем WC.
+ * Индекс 4 выбирается битом PAT при PCD = PWT = 0. */
+#define MSR_PAT 0x277
+#define PAT_LOW 0x00070406
+#define PAT_HIGH 0x00070401
+
+#define VGA_START 0xA0000
+#define VGA_END 0xC0000
+
+#define PDE_INDEX(addr) ((addr) >> 22)
+#define PTE_INDEX(addr) (((addr) >> 12) & 0x3FF)
+
+static u32 page_directory[1024] __attribute__((aligned(PAGE_SIZE)));
+static u32 low_table[1024] __attribute__((aligned(PAGE_SIZE)));    // первые 4 МБ
+
+static u8 has_pse = 0;
+static u8 has_pge = 0;
+static u8 has_pat = 0;
+static u8 paging_enabled = 0;
+
+static u32 large_pages = 0;
+static u32 page_tables = 0;
+
+static u32 cache_bits(paging_cache_t cache, int large) {
+    switch (cache) {
+        case PAGING_CACHE_WT:
+            return PAGE_PWT;
+        case PAGING_CACHE_UC:
+            return PAGE_PCD | PAGE_PWT;
+        case PAGING_CACHE_WC:
+            if (has_pat) {
+                return large ? PAGE_PAT_4M : PAGE_PAT_4K;
+            }
+            return PAGE_PCD | PAGE_PWT;
+        default:
+            return 0;
+    }
+}
+
+static void invalidate_page(u32 addr) {
+    if (paging_enabled) {
+        __asm__ volatile("invlpg (%0)" : : "r"(addr) : "memory");
+    }
+}
+
+// сброс всего TLB, включая глобальные страницы
+static void flush_tlb() {
+    if (!paging_enabled) {
+        return;
+    }
+
+    u32 cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    if (cr4 & CR4_PGE) {
+        __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 & ~CR4_PGE) : "memory");
+        __asm__ volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+    } else {
+        __asm__ volatile("mov %%cr3, %%eax; mov %%eax, %%cr3" : : : "eax", "memory");
+    }
+}
+
+// таблица страниц берется из кучи: куча уже отображена и не мешает ей расти
+static u32* table_alloc() {
+    u32* table = (u32*)kmalloc_aligned(PAGE_SIZE, PAGE_SIZE);
+    if (table) {
+        memset(table, 0, PAGE_SIZE);
+        page_tables++;
+    }
+    return table;
+}
+
+// таблица для записи каталога; страница 4 МБ разбивается на 1024 страницы с теми же атрибутами
+static u32* get_table(u32 pde_index) {
+    u32 pde = page_directory[pde_index];
+
+    if (!(pde & PAGE_PRESENT)) {
+        u32* table = table_alloc();
+        if (table) {
+            page_directory[pde_index] = (u32)table | PAGE_PRESENT | PAGE_WRITE;
+        }
+        return table;
+    }
+
+    if (!(pde & PAGE_LARGE)) {
+        return (u32*)(pde & PAGE_FRAME_4K);
+    }
+
+    u32* table = table_alloc();
+    if (!table) {
+        return NULL;
+    }
+
+    u32 base = pde & PAGE_FRAME_4M;
+    u32 flags = pde & (PAGE_PRESENT | PAGE_WRITE | PAGE_USER | PAGE_PWT | PAGE_PCD | PAGE_GLOBAL);
+    if (pde & PAGE_PAT_4M) {
+        flags |= PAGE_PAT_4K;
+    }
+
+    for (u32 i = 0; i < 1024; i++) {
+        table[i] = (base + i * PAGE_SIZE) | flags;
+    }
+
+    page_directory[pde_index] = (u32)table | PAGE_PRESENT | PAGE_WRITE;
+    large_pages--;
+    flush_tlb();
+
+    return table;
+}
+
+static void page_fault_handler(registers_t* regs) {
+    u32 fault_addr;
+    __asm__ volatile("mov %%cr2, %0" : "=r"(fault_addr));
+
+    printf_panic_screen(
+        "Page Fault",
+        "Address 0x%x, EIP 0x%x, error 0x%x:\n%s, %s, %s%s%s",
+        fault_addr,
+        regs->eip,
+        regs->err_code,
+        (regs->err_code & PF_PRESENT) ? "protection violation" : "page not present",
+        (regs->err_code & PF_WRITE) ? "write" : "read",
+        (regs->err_code & PF_USER) ? "user mode" : "kernel mode",
+        (regs->err_code & PF_RESERVED) ? ", reserved bit set" : "",
+        (regs->err_code & PF_FETCH) ? ", instruction fetch" : "");
+}
+
+void paging_init() {
+    u32 eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    has_pse = (edx & CPUID_PSE) != 0;
+    has_pge = (edx & CPUID_PGE) != 0;
+    has_pat = (edx & CPUID_PAT) != 0;
+
+    u32 global = has_pge ? PAGE_GLOBAL : 0;
+
+    memset(page_directory, 0, sizeof(page_directory));
+
+    // Первые 4 МБ (ядро, стек, BIOS, видеопамять) - страницами по 4 КБ
+    for (u32 i = 0; i < 1024; i++) {
+        u32 addr = i * PAGE_SIZE;
+
+        if (addr >= VGA_START && addr < VGA_END) {
+            low_table[i] = addr | PAGE_PRESENT | PAGE_WRITE | cache_bits(PAGING_CACHE_WC, 0);
+        } else {
+            low_table[i] = addr | PAGE_PRESENT | PAGE_WRITE | global;
+        }
+    }
+    page_directory[0] = (u32)low_table | PAGE_PRESENT | PAGE_WRITE;
+    page_tables++;
+
+    // Остальная RAM (в том числе куча) - страницами по 4 МБ, без PSE - таблицами
+    u32 top = pmm_get_info().memory_top;
+    u32 pde_count = PDE_INDEX(top) + ((top & (PAGE_LARGE_SIZE - 1)) != 0);
+
+    for (u32 i = 1; i < pde_count; i++) {
+        u32 base = i << 22;
+
+        if (has_pse) {
+            page_directory[i] = base | PAGE_PRESENT | PAGE_WRITE | PAGE_LARGE | global;
+            large_pages++;
+            continue;
+        }
+
+        u32* table = table_alloc();
+        if (!table) {
+            printf_colored("Paging: no memory for page tables above 0x%x\n", RED_ON_BLACK, base);
+            break;
+        }
+        for (u32 j = 0; j < 1024; j++) {
+            table[j] = (base + j * PAGE_SIZE) | PAGE_PRESENT | PAGE_WRITE | global;
+        }
+        page_directory[i] = (u32)table | PAGE_PRESENT | PAGE_WRITE;
+    }
+
+    register_interrupt_handler(14, page_fault_handler);
+
+    if (has_pat) {
+        __asm__ volatile("wbinvd; wrmsr" : : "c"(MSR_PAT), "a"(PAT_LOW), "d"(PAT_HIGH) : "memory");
+    }
+
+    u32 cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    if (has_pse) {
+        cr4 |= CR4_PSE;
+    }
+    if (has_pge) {
+        cr4 |= CR4_PGE;
+    }
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4));
+
+    __asm__ volatile("mov %0, %%cr3" : : "r"(page_directory) : "memory");
+
+    u32 cr0;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile("mov %0, %%cr0" : : "r"(cr0 | CR0_PG) : "memory");
+    paging_enabled = 1;
+
+    printf(
+        "Paging enabled: %d MB identity mapped, %d large pages, %d page tables\n",
+        (pde_count > 1 ? pde_count : 1) * 4,
+        large_pages,
+        page_tables);
+}
+
+int paging_map_region(u32 addr, u32 size, paging_cache_t cache) {
+    u32 page = addr & PAGE_FRAME_4K;
+    u32 count = ((addr & (PAGE_SIZE - 1)) + size + PAGE_SIZE - 1) / PAGE_SIZE;
+    u32 flags = PAGE_PRESENT | PAGE_WRITE | cache_bits(cache, 0);
+
+    for (u32 i = 0; i < count; i++, page += PAGE_SIZE) {
+        u32* table = get_table(PDE_INDEX(page));
+        if (!table) {
+            return 0;
+        }
+
+        table[PTE_INDEX(page)] = page | flags;
+        invalidate_page(page);
+    }
+
+    return 1;
+}
+
+int paging_is_mapped(u32 addr) {
+    u32 pde = page_directory[PDE_INDEX(addr)];
+
+    if (!(pde & PAGE_PRESENT)) {
+        return 0;
+    }
+    if (pde & PAGE_LARGE) {
+        return 1;
+    }
+
+    return (((u32*)(pde & PAGE_FRAME_4K))[PTE_INDEX(addr)] & PAGE_PRESENT) != 0;
+}
+
+void paging_dump() {
+    printf(
+        "Paging: %s, PSE %s, PGE %s, PAT %s\n",
+        paging_enabled ? "enabled" : "disabled",
+        has_pse ? "yes" : "no",
+        has_pge ? "yes" : "no",
+        has_pat ? "yes" : "no");
+    printf("  4 MB pages: %d, page tables: %d\n", large_pages, page_tables);
+}
@@ -0,0 +1,76 @@
+#ifndef PAGING_H
+#define PAGING_H
+
+#include "../kklibc/ctypes.h"
+
+#define PAGE_SIZE 0x1000
+#define PAGE_LARGE_SIZE 0x400000    // страница PSE (одна запись каталога)
+
+/* Биты записей каталога страниц (PDE) и таблиц страниц (PTE) */
+#define PAGE_PRESENT 0x001
+#define PAGE_WRITE 0x002
+#define PAGE_USER 0x004
+#define PAGE_PWT 0x008    // write-through
+#define PAGE_PCD 0x010    // кэширование запрещено
+#define PAGE_ACCESSED 0x020
+#define PAGE_DIRTY 0x040
+#define PAGE_LARGE 0x080    // в PDE: страница 4 МБ (PSE)
+#define PAGE_PAT_4K 0x080    // в PTE: бит PAT
+#define PAGE_GLOBAL 0x100
+#define PAGE_PAT_4M 0x1000    // в PDE страницы 4 МБ: бит PAT
+
+#define PAGE_FRAME_4K 0xFFFFF000
+#define PAGE_FRAME_4M 0xFFC00000
+
+/* Биты кода ошибки страничного нарушения */
+#define PF_PRESENT 0x01    // 0 - страница отсутствует, 1 - нарушение прав
+#define PF_WRITE 0x02
+#define PF_USER 0x04
+#define PF_RESERVED 0x08
+#define PF_FETCH 0x10
+
+/**
+ * @brief Тип кэширования региона
+ *
+ **/
+typedef enum {
+    PAGING_CACHE_WB = 0,    // write-back (обычная память)
+    PAGING_CACHE_WT,    // write-through
+    PAGING_CACHE_UC,    // без кэширования (регистры устройств)
+    PAGING_CACHE_WC,    // write-combining через PAT (без PAT - как UC)
+} paging_cache_t;
+
+/**
+ * @brief Включение страничной адресации
+ *
+ * Вся доступная RAM отображается сама на себя страницами по 4 МБ (PSE), первые
+ * 4 МБ (BIOS, VGA) - страницами по 4 КБ. Вызывается после pmm_init.
+ **/
+void paging_init();
+
+/**
+ * @brief Тождественное отображение региона страницами 4 КБ (MMIO, видеопамять)
+ *
+ * Страница 4 МБ, внутри которой лежит регион, разбивается на страницы по 4 КБ.
+ *
+ * @param addr начало региона
+ * @param size размер в байтах
+ * @param cache тип кэширования
+ * @return int 1 - успех, 0 - не хватило памяти под таблицу страниц
+ **/
+int paging_map_region(u32 addr, u32 size, paging_cache_t cache);
+
+/**
+ * @brief Проверка, отображен ли адрес
+ *
+ * @param addr адрес
+ * @return int 1 - отображен
+ **/
+int paging_is_mapped(u32 addr);
+
+/**
+ * @brief Вывод состояния страничной адресации
+ **/
+void paging_dump();
+
+#endif
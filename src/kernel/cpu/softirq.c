@@ -0,0 +1,107 @@
+#include "softirq.h"
+
+#include "../kklibc/stdio.h"
+#include "isr.h"
+#include "timer.h"
+
+static tasklet_t* queue_head = NULL;
+static tasklet_t** queue_tail = &queue_head;
+static volatile u8 softirq_active = 0;
+
+static u32 softirq_passes = 0;
+static u32 tasklet_runs = 0;
+static u32 max_batch = 0;
+static u64 max_cycles = 0;    // самый долгий обработчик tasklet в тактах TSC
+
+void tasklet_init(tasklet_t* tasklet, tasklet_fn_t fn, void* data) {
+    tasklet->next = NULL;
+    tasklet->scheduled = 0;
+    tasklet->fn = fn;
+    tasklet->data = data;
+    tasklet->run_count = 0;
+}
+
+void tasklet_schedule(tasklet_t* tasklet) {
+    u32 flags = irq_save();
+
+    if (!tasklet->scheduled) {
+        tasklet->scheduled = 1;
+        tasklet->next = NULL;
+        *queue_tail = tasklet;
+        queue_tail = &tasklet->next;
+    }
+
+    irq_restore(flags);
+}
+
+void softirq_run() {
+    u32 flags = irq_save();
+
+    if (softirq_active || in_interrupt()) {
+        irq_restore(flags);
+        return;
+    }
+    softirq_active = 1;
+
+    // пока обработчики работают, IRQ могут поставить новые tasklet - забираем очередь заново
+    while (queue_head) {
+        tasklet_t* list = queue_head;
+        queue_head = NULL;
+        queue_tail = &queue_head;
+        softirq_passes++;
+
+        irqstat_irqs_on();
+        __asm__ volatile("sti" : : : "memory");
+
+        u32 batch = 0;
+        u8 has_tsc = timer_tsc_khz() != 0;    // без TSC время обработчиков не меряем
+        while (list) {
+            tasklet_t* tasklet = list;
+            list = tasklet->next;    // до сброса scheduled: после него IRQ может перезаписать next
+            tasklet->scheduled = 0;
+
+            u64 start = has_tsc ? rdtsc() : 0;
+            tasklet->fn(tasklet->data);
+            u64 cycles = has_tsc ? rdtsc() - start : 0;
+
+            tasklet->run_count++;
+            tasklet_runs++;
+            batch++;
+            if (cycles > max_cycles) {
+                max_cycles = cycles;
+            }
+        }
+
+        __asm__ volatile("cli" : : : "memory");
+        irqstat_irqs_off();
+        if (batch > max_batch) {
+            max_batch = batch;
+        }
+    }
+
+    softirq_active = 0;
+    irq_restore(flags);
+}
+
+void softirq_idle() {
+    for (;;) {
+        softirq_run();
+
+        // проверка очереди и hlt без окна: sti действует после hlt, IRQ не теряется
+        __asm__ volatile("cli" : : : "memory");
+        if (queue_head) {
+            __asm__ volatile("sti" : : : "memory");
+        } else {
+            __asm__ volatile("sti; hlt" : : : "memory");
+        }
+    }
+}
+
+void softirq_dump() {
+    printf(
+        "Softirq: %u passes, %u tasklets, max batch %u, longest %llu ns\n",
+        softirq_passes,
+        tasklet_runs,
+        max_batch,
+        timer_cycles_to_ns(max_cycles));
+}
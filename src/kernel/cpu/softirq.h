@@ -0,0 +1,61 @@
+#ifndef SOFTIRQ_H
+#define SOFTIRQ_H
+
+#include "../kklibc/ctypes.h"
+
+typedef void (*tasklet_fn_t)(void* data);
+
+/**
+ * @brief Отложенная работа обработчика IRQ. Память выделяет вызывающий код,
+ * пока tasklet стоит в очереди, структура должна оставаться на месте
+ *
+ **/
+typedef struct tasklet {
+    struct tasklet* next;
+    volatile u8 scheduled;    // 1 - стоит в очереди, повторный tasklet_schedule ничего не делает
+    tasklet_fn_t fn;
+    void* data;
+    u32 run_count;
+} tasklet_t;
+
+/**
+ * @brief Инициализация tasklet
+ *
+ * @param tasklet tasklet
+ * @param fn обработчик
+ * @param data аргумент обработчика
+ **/
+void tasklet_init(tasklet_t* tasklet, tasklet_fn_t fn, void* data);
+
+/**
+ * @brief Постановка tasklet в очередь
+ *
+ * Можно вызывать из обработчика IRQ. Обработчик tasklet выполнится один раз,
+ * сколько бы раз его ни поставили до запуска.
+ *
+ * @param tasklet tasklet
+ **/
+void tasklet_schedule(tasklet_t* tasklet);
+
+/**
+ * @brief Выполнение очереди отложенной работы
+ *
+ * Вызывается на выходе из irq_handler и в цикле простоя. Обработчики tasklet
+ * работают с разрешенными прерываниями и не вкладываются друг в друга: если
+ * очередь уже выполняется, вызов сразу возвращается.
+ **/
+void softirq_run();
+
+/**
+ * @brief Цикл простоя: выполнение отложенной работы и hlt до следующего прерывания
+ *
+ **/
+void softirq_idle() __attribute__((noreturn));
+
+/**
+ * @brief Вывод статистики отложенной работы
+ *
+ **/
+void softirq_dump();
+
+#endif
@@ -2,25 +2,457 @@
 
 #include "../drivers/lowlevel_io.h"
 #include "../kklibc/function.h"
+#include "../kklibc/math.h"
+#include "../kklibc/stdio.h"
+#include "apic.h"
+#include "clocksource.h"
 #include "isr.h"
 
-u32 tick = 0;
+#define CPUID_TSC (1 << 4)
 
-static void timer_callback(registers_t regs) {
+#define PIT_CHANNEL0 0x40
+#define PIT_CHANNEL2 0x42
+#define PIT_COMMAND 0x43
+#define PIT_GATE 0x61    // бит 0 - вход GATE канала 2, бит 1 - динамик, бит 5 - выход канала 2
+#define PIC1_DATA 0x21
+
+#define PIT_MAX_COUNT 0xFFFF    // самый долгий однократный отсчет
+#define PIT_MAX_NS 54925000ull    // PIT_MAX_COUNT в наносекундах
+
+#define CALIBRATE_MS 10
+#define CALIBRATE_RUNS 3
+#define MIN_TSC_KHZ 4000    // ниже множитель для перевода в наносекунды не помещается в 32 бита
+
+volatile u32 tick = 0;
+
+/* Перевод тактов TSC в наносекунды: ns = cycles * tsc_mult >> tsc_shift,
+ * tsc_shift подобран так, чтобы множитель был максимальным, но помещался в 32 бита. */
+static u32 tsc_khz = 0;
+static u32 tsc_mult = 0;
+static u32 tsc_shift = 0;
+
+/* Колесо таймеров. Слоты - односвязные списки с pprev, чтобы таймер снимался за O(1)
+ * из любого списка, в том числе из локального списка срабатывающего слота.
+ * wheel_clk - текущий слот нулевого уровня (срок >> TIMER_WHEEL_SHIFT), все более ранние
+ * слоты пусты. */
+static ktimer_t* wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SIZE];
+static u64 wheel_clk = 0;
+static u32 wheel_count = 0;    // запущенных таймеров
+
+/* Источник прерываний таймера. Время всегда идет по TSC (или по тикам PIT без TSC),
+ * источник только будит процессор к ближайшему сроку. */
+typedef enum {
+    EVENT_PIT_PERIODIC = 0,    // без TSC: тики TIMER_HZ
+    EVENT_PIT_ONESHOT,
+    EVENT_APIC_ONESHOT,
+    EVENT_APIC_TSC_DEADLINE,
+} timer_event_t;
+
+static timer_event_t event_source = EVENT_PIT_PERIODIC;
+static u64 armed_deadline = 0;    // на какой срок взведен источник (0 - остановлен)
+
+static const char* event_names[] = { "PIT periodic", "PIT one-shot", "APIC one-shot", "APIC TSC-deadline" };
+
+#define WHEEL_SLOT(unit, level) (((unit) >> ((level) * TIMER_WHEEL_BITS)) & (TIMER_WHEEL_SIZE - 1))
+
+static void wheel_link(ktimer_t** head, ktimer_t* timer) {
+    timer->next = *head;
+    if (*head) {
+        (*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+}
+
+static void wheel_unlink(ktimer_t* timer) {
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+// уровень выбирается по расстоянию от wheel_clk: чем дальше срок, тем грубее слот
+static void wheel_insert(ktimer_t* timer) {
+    u64 unit = timer->expires >> TIMER_WHEEL_SHIFT;
+    u32 level = 0;
+
+    if (unit < wheel_clk) {
+        unit = wheel_clk;    // срок уже прошел: в текущий слот
+    }
+
+    u64 delta = unit - wheel_clk;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ull << ((level + 1) * TIMER_WHEEL_BITS))) {
+        level++;
+    }
+    if (delta >= (1ull << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS))) {
+        unit = wheel_clk + (1ull << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1;
+    }
+
+    wheel_link(&wheel[level][WHEEL_SLOT(unit, level)], timer);
+}
+
+// перекладывание слота уровня на уровень ниже; возвращает номер слота
+static u32 wheel_cascade(u32 level) {
+    u32 index = WHEEL_SLOT(wheel_clk, level);
+    ktimer_t* list = wheel[level][index];
+
+    wheel[level][index] = NULL;
+    while (list) {
+        ktimer_t* timer = list;
+        list = timer->next;
+        timer->next = NULL;
+        wheel_insert(timer);
+    }
+    return index;
+}
+
+// есть ли что перекладывать, когда wheel_clk дойдет до unit (начала оборота нулевого уровня)
+static int wheel_cascade_pending(u64 unit) {
+    for (u32 level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        u32 index = WHEEL_SLOT(unit, level);
+        if (wheel[level][index]) {
+            return 1;
+        }
+        if (index != 0) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// срабатывание наступивших таймеров текущего слота
+static void wheel_expire(u64 now) {
+    ktimer_t** slot = &wheel[0][WHEEL_SLOT(wheel_clk, 0)];
+    ktimer_t* list = *slot;
+
+    // слот переносится в локальный список: обработчики могут ставить и снимать таймеры
+    *slot = NULL;
+    if (list) {
+        list->pprev = &list;
+    }
+
+    while (list) {
+        ktimer_t* timer = list;
+        wheel_unlink(timer);
+
+        if (timer->expires > now) {
+            wheel_link(slot, timer);    // тот же слот, но срок еще не наступил
+            continue;
+        }
+
+        wheel_count--;
+        timer->fn(timer->data);
+    }
+}
+
+static void pit_oneshot(u64 delta) {
+    if (delta > PIT_MAX_NS) {
+        delta = PIT_MAX_NS;
+    }
+
+    // с округлением вверх: прерывание не раньше срока
+    u32 count = (u32)div64_u32(delta * PIT_FREQUENCY + NS_PER_SEC - 1, NS_PER_SEC, NULL);
+    if (count < 1) {
+        count = 1;
+    }
+    if (count > PIT_MAX_COUNT) {
+        count = PIT_MAX_COUNT;
+    }
+
+    port_byte_out(PIT_COMMAND, 0x30); /* канал 0, младший и старший байты, режим 0 (однократно) */
+    port_byte_out(PIT_CHANNEL0, count & 0xFF);
+    port_byte_out(PIT_CHANNEL0, (count >> 8) & 0xFF);
+}
+
+static void timer_stop() {
+    if (event_source == EVENT_PIT_ONESHOT) {
+        port_byte_out(PIT_COMMAND, 0x30); /* канал 0, режим 0 без начального значения: счет стоит */
+    } else {
+        apic_timer_stop();
+    }
+}
+
+// значение TSC через delta наносекунд, с округлением вверх (часы могут идти не по TSC)
+static u64 ns_to_tsc(u64 delta) {
+    u32 rem;
+    u64 ms = div64_u32(delta, NS_PER_MS, &rem);
+
+    return rdtsc() + ms * tsc_khz + div64_u32((u64)rem * tsc_khz + NS_PER_MS - 1, NS_PER_MS, NULL);
+}
+
+// источник взводится на ближайший срок (PIT - не дальше PIT_MAX_COUNT); без таймеров - останавливается
+static void timer_program(u64 now) {
+    if (event_source == EVENT_PIT_PERIODIC) {
+        return;
+    }
+
+    u64 next = 0;
+    for (u32 i = 0; i < TIMER_WHEEL_SIZE && wheel_count; i++) {
+        for (ktimer_t* timer = wheel[0][WHEEL_SLOT(wheel_clk + i, 0)]; timer; timer = timer->next) {
+            if (next == 0 || timer->expires < next) {
+                next = timer->expires;
+            }
+        }
+        if (next) {
+            break;
+        }
+    }
+
+    // нулевой уровень пуст или старшие уровни наступят раньше найденного: проснуться к перекладыванию
+    u64 boundary = ((wheel_clk >> TIMER_WHEEL_BITS) + 1) << TIMER_WHEEL_BITS;
+    int cascade_first = (next >> TIMER_WHEEL_SHIFT) >= boundary && wheel_cascade_pending(boundary);
+    if (wheel_count && (next == 0 || cascade_first)) {
+        next = boundary << TIMER_WHEEL_SHIFT;
+    }
+
+    if (next == 0) {
+        if (armed_deadline) {
+            timer_stop();
+            armed_deadline = 0;
+        }
+        return;
+    }
+
+    u64 delta = next > now ? next - now : 0;
+
+    armed_deadline = next;
+    switch (event_source) {
+        case EVENT_PIT_ONESHOT:
+            pit_oneshot(delta);
+            break;
+        case EVENT_APIC_ONESHOT:
+            apic_timer_oneshot(delta);
+            break;
+        case EVENT_APIC_TSC_DEADLINE:
+            apic_timer_deadline(ns_to_tsc(delta));
+            break;
+        default:
+            break;
+    }
+}
+
+static void timer_run(u64 now) {
+    u64 now_unit = now >> TIMER_WHEEL_SHIFT;
+
+    for (;;) {
+        if (wheel_count == 0) {
+            wheel_clk = now_unit > wheel_clk ? now_unit : wheel_clk;
+            break;
+        }
+
+        wheel_expire(now);
+        if (wheel_clk >= now_unit) {
+            break;
+        }
+
+        wheel_clk++;
+        for (u32 level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if (WHEEL_SLOT(wheel_clk, level - 1) != 0 || wheel_cascade(level) != 0) {
+                break;
+            }
+        }
+    }
+
+    armed_deadline = 0;
+    timer_program(now);
+}
+
+static void timer_callback(registers_t* regs) {
     tick++;
+    timer_run(timer_monotonic_ns());
     UNUSED(regs);
 }
 
+// такты за CALIBRATE_MS по однократному отсчету канала 2 PIT (вход GATE управляется портом 0x61)
+static u64 calibrate_run() {
+    u32 latch = PIT_FREQUENCY / (1000 / CALIBRATE_MS);
+
+    port_byte_out(PIT_GATE, (port_byte_in(PIT_GATE) & ~0x02) | 0x01);
+    port_byte_out(PIT_COMMAND, 0xB0); /* канал 2, младший и старший байты, режим 0 */
+    port_byte_out(PIT_CHANNEL2, latch & 0xFF);
+    port_byte_out(PIT_CHANNEL2, latch >> 8);
+
+    u64 start = rdtsc();
+    while (!(port_byte_in(PIT_GATE) & 0x20)) {
+    }
+    return rdtsc() - start;
+}
+
+static void calibrate_tsc() {
+    u32 eax, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
+    if (!(edx & CPUID_TSC)) {
+        return;
+    }
+
+    // минимум из нескольких замеров: SMI и эмулятор могут только удлинить замер
+    u32 flags = irq_save();
+    u64 best = 0;
+    for (u32 i = 0; i < CALIBRATE_RUNS; i++) {
+        u64 cycles = calibrate_run();
+        if (best == 0 || cycles < best) {
+            best = cycles;
+        }
+    }
+    irq_restore(flags);
+
+    u64 khz = div64_u32(best, CALIBRATE_MS, NULL);
+    if (khz < MIN_TSC_KHZ || khz > 0xFFFFFFFF) {
+        return;
+    }
+
+    tsc_shift = 32;
+    while (div64_u32((u64)NS_PER_MS << tsc_shift, (u32)khz, NULL) > 0xFFFFFFFF) {
+        tsc_shift--;
+    }
+    tsc_mult = (u32)div64_u32((u64)NS_PER_MS << tsc_shift, (u32)khz, NULL);
+    tsc_khz = (u32)khz;
+}
+
 void init_timer(u32 freq) {
     /* Install the function we just wrote */
-    register_interrupt_handler(IRQ0, timer_callback);
-
-    /* Get the PIT value: hardware clock at 1193180 Hz */
-    u32 divisor = 1193180 / freq;
-    u8 low = (u8)(divisor & 0xFF);
-    u8 high = (u8)((divisor >> 8) & 0xFF);
-    /* Send the command */
-    port_byte_out(0x43, 0x36); /* Command port */
-    port_byte_out(0x40, low);
-    port_byte_out(0x40, high);
+    register_interrupt_handler_fast(IRQ0, timer_callback);
+
+    calibrate_tsc();
+    if (tsc_khz) {
+        irqstat_enable();
+    }
+
+    if (tsc_khz) {
+        // время идет по часам (clocksource), PIT нужен только к срокам таймеров
+        event_source = EVENT_PIT_ONESHOT;
+        port_byte_out(PIT_COMMAND, 0x30); /* канал 0, режим 0, счет стоит до первого timer_add */
+        printf("TSC: %u.%03u MHz, calibrated against PIT; tickless timer\n", tsc_khz / 1000, tsc_khz % 1000);
+    } else {
+        /* Get the PIT value: hardware clock at 1193180 Hz */
+        u32 divisor = PIT_FREQUENCY / freq;
+        u8 low = (u8)(divisor & 0xFF);
+        u8 high = (u8)((divisor >> 8) & 0xFF);
+        /* Send the command */
+        port_byte_out(PIT_COMMAND, 0x36); /* Command port */
+        port_byte_out(PIT_CHANNEL0, low);
+        port_byte_out(PIT_CHANNEL0, high);
+
+        printf("TSC: not available, periodic timer at %u Hz\n", freq);
+    }
+
+    // канал 2 PIT освободился после калибровки и становится запасным источником времени
+    clocksource_init_early(tsc_khz);
+}
+
+void init_apic_timer() {
+    if (!apic_init()) {
+        printf("Local APIC timer: not available, using PIT\n");
+        return;
+    }
+
+    u32 flags = irq_save();
+
+    // PIT больше не нужен: останавливаем, сроки переходят на APIC с тем же обработчиком
+    port_byte_out(PIT_COMMAND, 0x30);
+    register_interrupt_handler_fast(APIC_TIMER_VECTOR, timer_callback);
+    event_source = apic_has_tsc_deadline() ? EVENT_APIC_TSC_DEADLINE : EVENT_APIC_ONESHOT;
+    armed_deadline = 0;
+    timer_program(timer_monotonic_ns());
+
+    irq_restore(flags);
+
+    printf(
+        "Local APIC timer: %u kHz, %s mode\n",
+        apic_timer_khz(),
+        event_source == EVENT_APIC_TSC_DEADLINE ? "TSC-deadline" : "one-shot");
+}
+
+const char* timer_event_source() {
+    return event_names[event_source];
+}
+
+u32 timer_tsc_khz() {
+    return tsc_khz;
+}
+
+u64 timer_cycles_to_ns(u64 cycles) {
+    // 64 x 32 бит: младшая и старшая половины умножаются отдельно
+    u64 low = (u64)(u32)cycles * tsc_mult;
+    u64 high = (u64)(u32)(cycles >> 32) * tsc_mult;
+
+    return (low >> tsc_shift) + (high << (32 - tsc_shift));
+}
+
+u64 timer_monotonic_ns() {
+    return clock_now_ns();
+}
+
+void timer_add(ktimer_t* timer, u64 expires, timer_fn_t fn, void* data) {
+    u32 flags = irq_save();
+
+    if (timer_pending(timer)) {
+        wheel_unlink(timer);
+        wheel_count--;
+    }
+    if (wheel_count == 0) {
+        // колесо пустое: догоняем текущее время без прохода по слотам
+        u64 now_unit = timer_monotonic_ns() >> TIMER_WHEEL_SHIFT;
+        wheel_clk = now_unit > wheel_clk ? now_unit : wheel_clk;
+    }
+
+    timer->expires = expires;
+    timer->fn = fn;
+    timer->data = data;
+    wheel_insert(timer);
+    wheel_count++;
+
+    if (armed_deadline == 0 || expires < armed_deadline) {
+        timer_program(timer_monotonic_ns());
+    }
+
+    irq_restore(flags);
+}
+
+int timer_cancel(ktimer_t* timer) {
+    u32 flags = irq_save();
+    int pending = timer_pending(timer);
+
+    if (pending) {
+        wheel_unlink(timer);
+        wheel_count--;
+    }
+
+    irq_restore(flags);
+    return pending;
+}
+
+static void timer_wakeup(void* data) {
+    UNUSED(data);
+}
+
+void timer_wait_until(u64 deadline_ns) {
+    ktimer_t wakeup = {0};
+    u32 flags = irq_save();
+    u8 pic_mask = 0;
+
+    // внутри обработчика IRQ нельзя пускать остальные прерывания: обработчики не реентерабельны
+    if (!(flags & EFLAGS_IF)) {
+        pic_mask = port_byte_in(PIC1_DATA);
+        port_byte_out(PIC1_DATA, event_source <= EVENT_PIT_ONESHOT ? 0xFE : 0xFF);    // APIC идет мимо 8259
+    }
+
+    timer_add(&wakeup, deadline_ns, timer_wakeup, NULL);
+    while (timer_monotonic_ns() < deadline_ns) {
+        irqstat_irqs_on();
+        __asm__ volatile("sti; hlt; cli" : : : "memory");    // sti действует после hlt: IRQ0 не теряется
+        irqstat_irqs_off();
+    }
+    timer_cancel(&wakeup);
+
+    if (!(flags & EFLAGS_IF)) {
+        port_byte_out(PIC1_DATA, pic_mask);
+    }
+    irq_restore(flags);
+}
+
+void timer_sleep_ns(u64 ns) {
+    timer_wait_until(timer_monotonic_ns() + ns);
 }
@@ -3,11 +3,140 @@
 
 #include "../kklibc/ctypes.h"
 
+#define TIMER_HZ 50    // частота IRQ0, если нет TSC и PIT работает периодически
+#define PIT_FREQUENCY 1193182    // входная частота PIT, Гц
+#define NS_PER_SEC 1000000000ull
+#define NS_PER_MS 1000000
+
+/* Иерархическое колесо таймеров: 4 уровня по 64 слота, слот нулевого уровня - 2^20 нс (~1 мс),
+ * каждый следующий уровень в 64 раза грубее. Дальше 2^44 нс (~4.9 часа) таймер ставится
+ * в последний слот и перекладывается, когда до него дойдет очередь. */
+#define TIMER_WHEEL_SHIFT 20
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SIZE (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+extern volatile u32 tick;    // число прерываний IRQ0 с момента init_timer
+
+typedef void (*timer_fn_t)(void* data);
+
+/**
+ * @brief Таймер ядра. Память выделяет вызывающий код, до срабатывания или timer_cancel
+ * структура должна оставаться на месте
+ *
+ **/
+typedef struct ktimer {
+    struct ktimer* next;
+    struct ktimer** pprev;    // ссылка на указатель, который указывает на таймер (NULL - не запущен)
+    u64 expires;    // срок по timer_monotonic_ns
+    timer_fn_t fn;
+    void* data;
+} ktimer_t;
+
 /**
- * @brief Инициализация таймера
+ * @brief Чтение счетчика тактов процессора
+ *
+ * @return u64 значение TSC
+ **/
+static inline u64 rdtsc() {
+    u32 low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((u64)high << 32) | low;
+}
+
+/**
+ * @brief Инициализация таймера и калибровка TSC по PIT
  *
  * @param freq частота
  **/
 void init_timer(u32 freq);
 
+/**
+ * @brief Перевод таймера на локальный APIC (TSC-deadline, если есть, иначе однократный режим)
+ *
+ * Вызывается после paging_init: регистры APIC отображаются в память. Обработчик
+ * прерывания тот же, что у IRQ0; без APIC или TSC таймер остается на PIT.
+ **/
+void init_apic_timer();
+
+/**
+ * @brief Источник прерываний таймера
+ *
+ * @return const char* название ("PIT periodic", "PIT one-shot", "APIC one-shot", "APIC TSC-deadline")
+ **/
+const char* timer_event_source();
+
+/**
+ * @brief Частота TSC, измеренная при загрузке
+ *
+ * @return u32 частота в кГц (0 - TSC нет, время считается по тикам IRQ0)
+ **/
+u32 timer_tsc_khz();
+
+/**
+ * @brief Монотонное время с момента init_timer (то же, что clock_now_ns)
+ *
+ * Идет по лучшему источнику из clocksource: TSC, HPET или канал 2 PIT.
+ *
+ * @return u64 наносекунды
+ **/
+u64 timer_monotonic_ns();
+
+/**
+ * @brief Перевод тактов TSC в наносекунды по результатам калибровки
+ *
+ * @param cycles число тактов
+ * @return u64 наносекунды (0, если TSC не откалиброван)
+ **/
+u64 timer_cycles_to_ns(u64 cycles);
+
+/**
+ * @brief Запуск таймера (если таймер уже запущен, его срок переносится)
+ *
+ * Обработчик вызывается из IRQ0 при запрещенных прерываниях, не раньше срока.
+ * При TSC PIT работает в однократном режиме и взводится на ближайший срок,
+ * поэтому без таймеров прерываний IRQ0 нет совсем.
+ *
+ * @param timer таймер
+ * @param expires срок по timer_monotonic_ns
+ * @param fn обработчик
+ * @param data аргумент обработчика
+ **/
+void timer_add(ktimer_t* timer, u64 expires, timer_fn_t fn, void* data);
+
+/**
+ * @brief Отмена таймера
+ *
+ * @param timer таймер
+ * @return int 1 - таймер был запущен и снят, 0 - уже сработал или не запускался
+ **/
+int timer_cancel(ktimer_t* timer);
+
+/**
+ * @brief Запущен ли таймер
+ *
+ * @param timer таймер
+ * @return int 1 - ожидает срабатывания
+ **/
+static inline int timer_pending(const ktimer_t* timer) {
+    return timer->pprev != NULL;
+}
+
+/**
+ * @brief Ожидание момента времени
+ *
+ * Ставит таймер на срок и спит в hlt до прерываний. Если прерывания запрещены
+ * (вызов из обработчика IRQ), на время ожидания разрешается только IRQ0.
+ *
+ * @param deadline_ns момент по timer_monotonic_ns
+ **/
+void timer_wait_until(u64 deadline_ns);
+
+/**
+ * @brief Ожидание заданного времени
+ *
+ * @param ns наносекунды
+ **/
+void timer_sleep_ns(u64 ns);
+
 #endif
@@ -0,0 +1,120 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS Drivers source code
+ *  File: kernel/drivers/acpi.c
+ *  Title: Таблицы ACPI
+ *  Author: alexeev-prog
+ *  License: MIT License
+ * ------------------------------------------------------------------------------
+ *	Description: RSDP ищется по сигнатуре "RSD PTR " с шагом 16 байт, дальше
+ *	используется RSDT с 32-битными адресами таблиц (она есть и в ACPI 2.0+).
+ * ----------------------------------------------------------------------------*/
+
+#include "acpi.h"
+
+#include "../cpu/paging.h"
+#include "../kklibc/stdlib.h"
+
+#define EBDA_SEGMENT_PTR 0x40E
+#define BIOS_AREA_START 0xE0000
+#define BIOS_AREA_END 0x100000
+
+/**
+ * @brief Указатель на корневую таблицу (RSDP, ACPI 1.0)
+ *
+ **/
+typedef struct {
+    char signature[8];    // "RSD PTR "
+    u8 checksum;
+    char oem_id[6];
+    u8 revision;
+    u32 rsdt_address;
+} __attribute__((packed)) acpi_rsdp_t;
+
+static const acpi_sdt_header_t* rsdt = NULL;
+static u8 rsdp_searched = 0;
+
+static u8 acpi_checksum(const void* data, u32 length) {
+    const u8* bytes = (const u8*)data;
+    u8 sum = 0;
+
+    for (u32 i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum;
+}
+
+// RAM уже отображена страницами по 4 МБ, их не нужно дробить
+static int acpi_map(u32 addr, u32 length) {
+    if (paging_is_mapped(addr) && paging_is_mapped(addr + length - 1)) {
+        return 1;
+    }
+    return paging_map_region(addr, length, PAGING_CACHE_WB);
+}
+
+// отображение таблицы: сначала заголовок, чтобы узнать длину, потом вся таблица
+static const acpi_sdt_header_t* acpi_map_table(u32 addr) {
+    if (addr == 0 || !acpi_map(addr, sizeof(acpi_sdt_header_t))) {
+        return NULL;
+    }
+
+    const acpi_sdt_header_t* header = (const acpi_sdt_header_t*)addr;
+    if (header->length < sizeof(acpi_sdt_header_t) || !acpi_map(addr, header->length)) {
+        return NULL;
+    }
+    if (acpi_checksum(header, header->length) != 0) {
+        return NULL;
+    }
+    return header;
+}
+
+static const acpi_rsdp_t* acpi_scan_rsdp(u32 start, u32 end) {
+    for (u32 addr = start; addr + sizeof(acpi_rsdp_t) <= end; addr += 16) {
+        const acpi_rsdp_t* rsdp = (const acpi_rsdp_t*)addr;
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 && acpi_checksum(rsdp, sizeof(acpi_rsdp_t)) == 0) {
+            return rsdp;
+        }
+    }
+    return NULL;
+}
+
+static void acpi_find_rsdt() {
+    rsdp_searched = 1;
+
+    // первый килобайт EBDA, затем область BIOS
+    u32 ebda = (u32)(*(u16*)EBDA_SEGMENT_PTR) << 4;
+    const acpi_rsdp_t* rsdp = NULL;
+    if (ebda >= 0x80000 && ebda < BIOS_AREA_START) {
+        rsdp = acpi_scan_rsdp(ebda, ebda + 1024);
+    }
+    if (!rsdp) {
+        rsdp = acpi_scan_rsdp(BIOS_AREA_START, BIOS_AREA_END);
+    }
+    if (!rsdp) {
+        return;
+    }
+
+    const acpi_sdt_header_t* table = acpi_map_table(rsdp->rsdt_address);
+    if (table && memcmp(table->signature, "RSDT", 4) == 0) {
+        rsdt = table;
+    }
+}
+
+const acpi_sdt_header_t* acpi_find_table(const char* signature) {
+    if (!rsdp_searched) {
+        acpi_find_rsdt();
+    }
+    if (!rsdt) {
+        return NULL;
+    }
+
+    const u32* entries = (const u32*)(rsdt + 1);
+    u32 count = (rsdt->length - sizeof(acpi_sdt_header_t)) / sizeof(u32);
+
+    for (u32 i = 0; i < count; i++) {
+        const acpi_sdt_header_t* table = acpi_map_table(entries[i]);
+        if (table && memcmp(table->signature, signature, 4) == 0) {
+            return table;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,44 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS Drivers source code
+ *  File: kernel/drivers/acpi.h
+ *  Title: Заголовочный файл для drivers/acpi.c
+ *  Author: alexeev-prog
+ *  License: MIT License
+ * ------------------------------------------------------------------------------
+ *	Description: Поиск таблиц ACPI (RSDP -> RSDT -> таблица по сигнатуре)
+ * ----------------------------------------------------------------------------*/
+
+#ifndef ACPI_H
+#define ACPI_H
+
+#include "../kklibc/ctypes.h"
+
+/**
+ * @brief Общий заголовок системной таблицы ACPI
+ *
+ **/
+typedef struct {
+    char signature[4];
+    u32 length;    // длина таблицы вместе с заголовком
+    u8 revision;
+    u8 checksum;    // сумма всех байтов таблицы равна 0
+    char oem_id[6];
+    char oem_table_id[8];
+    u32 oem_revision;
+    u32 creator_id;
+    u32 creator_revision;
+} __attribute__((packed)) acpi_sdt_header_t;
+
+/**
+ * @brief Поиск таблицы ACPI по сигнатуре
+ *
+ * При первом вызове ищет RSDP в EBDA и в области BIOS 0xE0000-0xFFFFF. Таблицы
+ * лежат в зарезервированной памяти выше кучи, поэтому их страницы отображаются
+ * через paging_map_region: вызывать после paging_init.
+ *
+ * @param signature сигнатура из 4 символов ("HPET", "APIC", ...)
+ * @return const acpi_sdt_header_t* таблица с верной контрольной суммой или NULL
+ **/
+const acpi_sdt_header_t* acpi_find_table(const char* signature);
+
+#endif
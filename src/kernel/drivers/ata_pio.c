@@ -25,6 +25,7 @@
 
 #include "ata_pio.h"
 
+#include "../cpu/timer.h"
 #include "../kklibc/kklibc.h"
 #include "lowlevel_io.h"
 #include "screen.h"
@@ -81,9 +82,9 @@ static void ata_pio_set_lba(u32 lba, u8 drive) {
 
 int ata_pio_wait() {
     // ожидаем снятия флага BSY и установки флага DRDY
-    int timeout = 100000;    // таймаут для предотвращения зависания
+    u64 deadline = timer_monotonic_ns() + ATA_PIO_TIMEOUT_MS * NS_PER_MS;    // таймаут против зависания
 
-    while (timeout-- > 0) {
+    while (timer_monotonic_ns() < deadline) {
         u8 status = port_byte_in(ATA_PRIMARY_STATUS);
 
         // коли BSY снят и DRDY установлен - диск готов
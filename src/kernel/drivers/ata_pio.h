@@ -24,6 +24,8 @@
 #define ATA_PRIMARY_STATUS 0x1F7
 #define ATA_PRIMARY_CMD 0x1F7
 
+#define ATA_PIO_TIMEOUT_MS 100    // ожидание готовности диска
+
 // Статусные биты регистра STATUS
 #define ATA_SR_BSY 0x80    // Drive busy
 #define ATA_SR_DRDY 0x40    // Drive ready
@@ -11,6 +11,7 @@
 #include "keyboard.h"
 
 #include "../cpu/isr.h"
+#include "../cpu/softirq.h"
 #include "../kernel/kernel.h"
 #include "../kklibc/function.h"
 #include "../kklibc/stdlib.h"
@@ -26,6 +27,16 @@ extern int shell_prompt_offset;
 
 static char key_buffer[256];
 
+#define SCANCODE_RING 64    // степень двойки: индексы берутся по маске
+
+/* Кольцо сканкодов: пишет только IRQ1, читает только tasklet клавиатуры */
+static volatile u8 scancode_ring[SCANCODE_RING];
+static volatile u32 ring_head = 0;
+static volatile u32 ring_tail = 0;
+static u32 ring_dropped = 0;    // сканкоды, пришедшие при полном кольце
+
+static tasklet_t keyboard_tasklet;
+
 #define SC_MAX 57
 
 // Состояния модификаторов
@@ -45,9 +56,8 @@ const char sc_ascii_upper[] = { '?', '?', '!', '@', '#', '$', '%', '^', '&', '*'
                                 'A', 'S', 'D', 'F', 'G', 'H', 'J', 'K', 'L', ':', '"', '~', '?', '|', 'Z',
                                 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?', '?', '?', '?', ' ' };
 
-static void keyboard_callback(registers_t regs) {
-    u8 scancode = port_byte_in(0x60);
-
+// разбор сканкода, правка строки ввода и вывод: выполняется отложенно, с разрешенными прерываниями
+static void keyboard_process(u8 scancode) {
     // Обработка отпускания клавиш (старший бит установлен)
     if (scancode & 0x80) {
         u8 released_key = scancode & 0x7F;
@@ -156,9 +166,37 @@ static void keyboard_callback(registers_t regs) {
                 break;
         }
     }
+}
+
+static void keyboard_drain(void* data) {
+    while (ring_tail != ring_head) {
+        u8 scancode = scancode_ring[ring_tail & (SCANCODE_RING - 1)];
+        ring_tail++;
+        keyboard_process(scancode);
+    }
+    UNUSED(data);
+}
+
+// в самом IRQ только забираем сканкод из контроллера, остальное - в tasklet
+static void keyboard_callback(registers_t* regs) {
+    u8 scancode = port_byte_in(0x60);
+
+    if (ring_head - ring_tail < SCANCODE_RING) {
+        scancode_ring[ring_head & (SCANCODE_RING - 1)] = scancode;
+        ring_head++;
+    } else {
+        ring_dropped++;
+    }
+
+    tasklet_schedule(&keyboard_tasklet);
     UNUSED(regs);
 }
 
+u32 keyboard_dropped() {
+    return ring_dropped;
+}
+
 void init_keyboard() {
-    register_interrupt_handler(IRQ1, keyboard_callback);
+    tasklet_init(&keyboard_tasklet, keyboard_drain, NULL);
+    register_interrupt_handler_fast(IRQ1, keyboard_callback);
 }
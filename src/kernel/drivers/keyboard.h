@@ -15,3 +15,10 @@
  *
  **/
 void init_keyboard();
+
+/**
+ * @brief Число сканкодов, потерянных из-за переполнения кольца
+ *
+ * @return u32 количество
+ **/
+u32 keyboard_dropped();
@@ -34,6 +34,8 @@ void terminal_init(void) {
     term_state.insert_mode = 0;
     term_state.dirty = 1;
     term_state.auto_scroll = 1;
+    term_state.batch = 0;
+    term_state.batch_lines = 0;
 
     clear_screen();
 
@@ -49,6 +51,7 @@ void terminal_init(void) {
 static void terminal_newline(void) {
     term_state.cursor_x = 0;
     term_state.cursor_y++;
+    term_state.batch_lines++;
 
     if (term_state.cursor_y >= TERMINAL_HEIGHT) {
         for (u32 y = 1; y < TERMINAL_HEIGHT; y++) {
@@ -110,13 +113,32 @@ void terminal_putchar(char c) {
     }
 }
 
+/* Перерисовка после вывода: сразу или, в пакетном режиме, раз в экран строк */
+static void terminal_output_done(void) {
+    if (!term_state.batch || term_state.batch_lines >= SCREEN_HEIGHT) {
+        terminal_refresh();
+    }
+}
+
+void terminal_write(const char* str, u32 len, u8 color) {
+    u8 old_color = term_state.current_attribute;
+    term_state.current_attribute = color;
+
+    for (u32 i = 0; i < len; i++) {
+        terminal_putchar(str[i]);
+    }
+
+    term_state.current_attribute = old_color;
+    terminal_output_done();
+}
+
 /* Вывод строки */
 void terminal_print(const char* str) {
     while (*str) {
         terminal_putchar(*str);
         str++;
     }
-    terminal_refresh();    // обновляем экран
+    terminal_output_done();
 }
 
 void terminal_print_at(char* str, int col, int row, int color) {
@@ -325,6 +347,17 @@ void terminal_refresh(void) {
     terminal_direct_render();
 
     term_state.dirty = 0;
+    term_state.batch_lines = 0;
+}
+
+void terminal_begin_batch(void) {
+    term_state.batch = 1;
+    term_state.batch_lines = 0;
+}
+
+void terminal_flush(void) {
+    term_state.batch = 0;
+    terminal_refresh();
 }
 
 void terminal_handle_input(char c) {
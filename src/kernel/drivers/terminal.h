@@ -40,6 +40,9 @@ typedef struct {
 
     u8 dirty;
     u8 auto_scroll;
+
+    u8 batch;    // пакетный вывод: перерисовка откладывается до terminal_flush
+    u32 batch_lines;    // строк выведено с последней перерисовки в пакетном режиме
 } terminal_state_t;
 
 /* Инициализация терминала */
@@ -51,6 +54,9 @@ void terminal_print(const char* str);
 void terminal_print_colored(const char* str, u8 color);
 void terminal_print_at(char* str, int col, int row, int color);
 
+/* Запись len символов цветом color без немедленной перерисовки (для потокового printf) */
+void terminal_write(const char* str, u32 len, u8 color);
+
 /* Управление курсором */
 void terminal_set_cursor(u32 x, u32 y);
 void terminal_get_cursor(u32* x, u32* y);
@@ -73,6 +79,11 @@ void terminal_clear_line(u32 line);
 /* Обновление экрана (рендеринг логического буфера на VGA) */
 void terminal_refresh(void);
 
+/* Пакетный вывод: пока он включен, экран перерисовывается не чаще раза в SCREEN_HEIGHT строк,
+ * terminal_flush выключает его и перерисовывает экран (вызывается в конце команды шелла) */
+void terminal_begin_batch(void);
+void terminal_flush(void);
+
 /* Обработка ввода (вызывается из keyboard.c) */
 void terminal_handle_input(char c);
 void terminal_handle_backspace(void);
@@ -13,7 +13,9 @@
 
 #include "../drivers/ata_pio.h"
 #include "../drivers/screen.h"
+#include "../kklibc/function.h"
 #include "../kklibc/mem.h"
+#include "../kklibc/slab.h"
 #include "../kklibc/stdio.h"
 #include "../kklibc/stdlib.h"
 
@@ -22,6 +24,13 @@
 static fat12_context_t ctx;
 static fat12_boot_sector_t boot_sector;
 
+/* Кэши часто выделяемых буферов (создаются в fat12_init, когда известна геометрия) */
+static kmem_cache_t* root_dir_cache = NULL;    // копия корневого каталога
+static kmem_cache_t* cluster_cache = NULL;    // буфер одного кластера
+static kmem_cache_t* chain_cache = NULL;    // цепочка кластеров до FAT12_CHAIN_CACHED элементов
+
+#define FAT12_CHAIN_CACHED 256
+
 /* Вспомогательные функции */
 static void format_filename(const char* input, char* output);
 static u16 fat12_get_fat_entry(u32 cluster);
@@ -30,21 +39,37 @@ static u16 fat12_find_free_cluster(void);
 static void fat12_free_cluster_chain(u16 start_cluster);
 static int fat12_find_free_dir_entry(u32* sector_out, u32* offset_out);
 static void fat12_sync_fat(void);
+static u16* fat12_chain_alloc(u32 count);
+static void fat12_chain_free(u16* chain, u32 count);
 
 /* -------------------------------------------------------------------------- */
 /* ИНИЦИАЛИЗАЦИЯ И ОЧИСТКА                                                   */
 /* -------------------------------------------------------------------------- */
 
 void fat12_cleanup(void) {
-    if (ctx.fat_buffer) {
-        // Перед освобождением, если FAT была изменена, нужно записать на диск
-        if (ctx.fat_buffer_loaded == 2) {    // 2 = изменена
-            fat12_sync_fat();
-        }
-        kfree(ctx.fat_buffer);
-        ctx.fat_buffer = NULL;
-        ctx.fat_buffer_loaded = 0;
+    // Если FAT была изменена, записываем ее на диск; буфер остается как кэш
+    if (ctx.fat_buffer && ctx.fat_buffer_loaded == 2) {    // 2 = изменена
+        fat12_sync_fat();
     }
+    ctx.fat_buffer_busy = 0;
+}
+
+// shrinker: буфер FAT между операциями можно прочитать с диска заново
+static u32 fat12_shrinker(u32 wanted) {
+    UNUSED(wanted);    // буфер один, отдаем целиком
+
+    if (!ctx.fat_buffer || ctx.fat_buffer_busy) {
+        return 0;
+    }
+
+    if (ctx.fat_buffer_loaded == 2) {
+        fat12_sync_fat();
+    }
+    kfree(ctx.fat_buffer);
+    ctx.fat_buffer = NULL;
+    ctx.fat_buffer_loaded = 0;
+
+    return ctx.fat_size_sectors * 512;
 }
 
 void fat12_init(void) {
@@ -73,6 +98,15 @@ void fat12_init(void) {
 
     ctx.fat_buffer = NULL;
     ctx.fat_buffer_loaded = 0;
+    ctx.fat_buffer_busy = 0;
+
+    if (!root_dir_cache) {
+        mem_register_shrinker("fat12_fat", fat12_shrinker);
+        root_dir_cache = kmem_cache_create("fat12_root", ctx.root_dir_size_sectors * 512, NULL);
+        cluster_cache = kmem_cache_create(
+            "fat12_cluster", boot_sector.sectors_per_cluster * boot_sector.bytes_per_sector, NULL);
+        chain_cache = kmem_cache_create("fat12_chain", FAT12_CHAIN_CACHED * sizeof(u16), NULL);
+    }
 
     printf(
         "FAT12 loaded: sectors %d-%d (size: %d sectors)\n",
@@ -111,9 +145,26 @@ void print_fat12_info(void) {
     printf("  Total data sectors: %d\n", boot_sector.total_sectors - ctx.data_start_sector);
 }
 
+// имя записи каталога в виде "NAME.EXT"
+static void entry_display_name(const fat12_dir_entry_t* entry, char* name) {
+    int pos = 0;
+
+    for (int j = 0; j < 8 && entry->filename[j] != ' '; j++) {
+        name[pos++] = entry->filename[j];
+    }
+
+    if (entry->extension[0] != ' ') {
+        name[pos++] = '.';
+        for (int j = 0; j < 3 && entry->extension[j] != ' '; j++) {
+            name[pos++] = entry->extension[j];
+        }
+    }
+
+    name[pos] = '\0';
+}
+
 void fat12_list_root(void) {
-    u32 buffer_size = ctx.root_dir_size_sectors * 512;
-    u8* buffer = (u8*)kmalloc(buffer_size);
+    u8* buffer = (u8*)kmem_cache_alloc(root_dir_cache);
 
     if (!buffer) {
         printf("No memory for root dir\n");
@@ -123,7 +174,7 @@ void fat12_list_root(void) {
     if (ata_pio_read_sectors(ATA_MASTER, ctx.root_dir_start_sector, ctx.root_dir_size_sectors, (u16*)buffer)
         != 0) {
         printf("Cannot read root dir\n");
-        kfree(buffer);
+        kmem_cache_free(root_dir_cache, buffer);
         return;
     }
 
@@ -143,24 +194,48 @@ void fat12_list_root(void) {
             continue;
         }
 
-        char name[13] = { 0 };
-        int pos = 0;
+        char name[FAT12_NAME_LEN];
+        entry_display_name(entry, name);
 
-        for (int j = 0; j < 8 && entry->filename[j] != ' '; j++) {
-            name[pos++] = entry->filename[j];
-        }
+        printf("%-12s  %6d bytes  cluster: %d\n", name, entry->file_size, entry->first_cluster);
+    }
 
-        if (entry->extension[0] != ' ') {
-            name[pos++] = '.';
-            for (int j = 0; j < 3 && entry->extension[j] != ' '; j++) {
-                name[pos++] = entry->extension[j];
-            }
+    kmem_cache_free(root_dir_cache, buffer);
+}
+
+int fat12_root_entries(void) {
+    return boot_sector.root_entries;
+}
+
+int fat12_root_names(char (*names)[FAT12_NAME_LEN], int max) {
+    u8* buffer = (u8*)kmem_cache_alloc(root_dir_cache);
+    int count = 0;
+
+    if (!buffer) {
+        return -1;
+    }
+
+    if (ata_pio_read_sectors(ATA_MASTER, ctx.root_dir_start_sector, ctx.root_dir_size_sectors, (u16*)buffer)
+        != 0) {
+        kmem_cache_free(root_dir_cache, buffer);
+        return -1;
+    }
+
+    for (int i = 0; i < boot_sector.root_entries && count < max; i++) {
+        fat12_dir_entry_t* entry = (fat12_dir_entry_t*)(buffer + i * 32);
+
+        if (entry->filename[0] == 0x00) {
+            break;
+        }
+        if ((u8)entry->filename[0] == 0xE5 || (entry->attributes & 0x08)) {
+            continue;
         }
 
-        printf("%-12s  %6d bytes  cluster: %d\n", name, entry->file_size, entry->first_cluster);
+        entry_display_name(entry, names[count++]);
     }
 
-    kfree(buffer);
+    kmem_cache_free(root_dir_cache, buffer);
+    return count;
 }
 
 /* -------------------------------------------------------------------------- */
@@ -204,6 +279,22 @@ static void format_filename(const char* input, char* output) {
     }
 }
 
+static u16* fat12_chain_alloc(u32 count) {
+    // короткие цепочки (почти все файлы) берем из кэша, длинные - из кучи
+    if (count <= FAT12_CHAIN_CACHED) {
+        return (u16*)kmem_cache_alloc(chain_cache);
+    }
+    return (u16*)kmalloc(count * sizeof(u16));
+}
+
+static void fat12_chain_free(u16* chain, u32 count) {
+    if (count <= FAT12_CHAIN_CACHED) {
+        kmem_cache_free(chain_cache, chain);
+    } else {
+        kfree(chain);
+    }
+}
+
 static void format_filename_from_entry(fat12_dir_entry_t* entry, char* out) {
     int i = 0;
 
@@ -222,6 +313,8 @@ static void format_filename_from_entry(fat12_dir_entry_t* entry, char* out) {
 }
 
 static void load_fat_if_needed(void) {
+    ctx.fat_buffer_busy = 1;    // до fat12_cleanup
+
     if (!ctx.fat_buffer_loaded) {
         u32 fat_size = ctx.fat_size_sectors * 512;
         ctx.fat_buffer = (u8*)kmalloc(fat_size);
@@ -354,8 +447,7 @@ static void fat12_sync_fat(void) {
 }
 
 static int fat12_find_free_dir_entry(u32* sector_out, u32* offset_out) {
-    u32 buffer_size = ctx.root_dir_size_sectors * 512;
-    u8* buffer = (u8*)kmalloc(buffer_size);
+    u8* buffer = (u8*)kmem_cache_alloc(root_dir_cache);
 
     if (!buffer) {
         printf("No memory for root dir\n");
@@ -365,7 +457,7 @@ static int fat12_find_free_dir_entry(u32* sector_out, u32* offset_out) {
     if (ata_pio_read_sectors(ATA_MASTER, ctx.root_dir_start_sector, ctx.root_dir_size_sectors, (u16*)buffer)
         != 0) {
         printf("Cannot read root dir\n");
-        kfree(buffer);
+        kmem_cache_free(root_dir_cache, buffer);
         return -1;
     }
 
@@ -377,12 +469,12 @@ static int fat12_find_free_dir_entry(u32* sector_out, u32* offset_out) {
             *sector_out = ctx.root_dir_start_sector + (i * 32) / 512;
             *offset_out = (i * 32) % 512;
 
-            kfree(buffer);
+            kmem_cache_free(root_dir_cache, buffer);
             return 0;    // Нашли свободное место
         }
     }
 
-    kfree(buffer);
+    kmem_cache_free(root_dir_cache, buffer);
     return -1;    // Нет свободного места
 }
 
@@ -394,8 +486,7 @@ int fat12_find_file(const char* filename, fat12_dir_entry_t* result) {
     char formatted_name[12];
     format_filename(filename, formatted_name);
 
-    u32 buffer_size = ctx.root_dir_size_sectors * 512;
-    u8* buffer = (u8*)kmalloc(buffer_size);
+    u8* buffer = (u8*)kmem_cache_alloc(root_dir_cache);
 
     if (!buffer) {
         return 0;
@@ -403,7 +494,7 @@ int fat12_find_file(const char* filename, fat12_dir_entry_t* result) {
 
     if (ata_pio_read_sectors(ATA_MASTER, ctx.root_dir_start_sector, ctx.root_dir_size_sectors, (u16*)buffer)
         != 0) {
-        kfree(buffer);
+        kmem_cache_free(root_dir_cache, buffer);
         return 0;
     }
 
@@ -423,12 +514,12 @@ int fat12_find_file(const char* filename, fat12_dir_entry_t* result) {
         // Сравниваем отформатированное имя
         if (memcmp(entry->filename, formatted_name, 11) == 0) {
             memcpy(result, entry, sizeof(fat12_dir_entry_t));
-            kfree(buffer);
+            kmem_cache_free(root_dir_cache, buffer);
             return 1;
         }
     }
 
-    kfree(buffer);
+    kmem_cache_free(root_dir_cache, buffer);
     return 0;
 }
 
@@ -549,8 +640,7 @@ int fat12_delete_file(const char* filename) {
     char formatted_name[12];
     format_filename(filename, formatted_name);
 
-    u32 buffer_size = ctx.root_dir_size_sectors * 512;
-    u8* buffer = (u8*)kmalloc(buffer_size);
+    u8* buffer = (u8*)kmem_cache_alloc(root_dir_cache);
 
     if (!buffer) {
         printf("No memory for root dir\n");
@@ -560,7 +650,7 @@ int fat12_delete_file(const char* filename) {
     if (ata_pio_read_sectors(ATA_MASTER, ctx.root_dir_start_sector, ctx.root_dir_size_sectors, (u16*)buffer)
         != 0) {
         printf("Cannot read root dir\n");
-        kfree(buffer);
+        kmem_cache_free(root_dir_cache, buffer);
         return -1;
     }
 
@@ -589,7 +679,7 @@ int fat12_delete_file(const char* filename) {
             u8 sector_buffer[512];
             if (ata_pio_read_sectors(ATA_MASTER, sector, 1, (u16*)sector_buffer) != 0) {
                 printf("Cannot read directory sector for write\n");
-                kfree(buffer);
+                kmem_cache_free(root_dir_cache, buffer);
                 return -1;
             }
 
@@ -598,16 +688,16 @@ int fat12_delete_file(const char* filename) {
 
             if (ata_pio_write_sectors(ATA_MASTER, sector, 1, (u16*)sector_buffer) != 0) {
                 printf("Cannot write directory sector\n");
-                kfree(buffer);
+                kmem_cache_free(root_dir_cache, buffer);
                 return -1;
             }
 
-            kfree(buffer);
+            kmem_cache_free(root_dir_cache, buffer);
             return 0;
         }
     }
 
-    kfree(buffer);
+    kmem_cache_free(root_dir_cache, buffer);
     printf("File not found in directory scan: %s\n", filename);
     return -1;
 }
@@ -646,8 +736,7 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
         char formatted_name[12];
         format_filename(filename, formatted_name);
 
-        u32 buffer_size = ctx.root_dir_size_sectors * 512;
-        u8* buffer = (u8*)kmalloc(buffer_size);
+        u8* buffer = (u8*)kmem_cache_alloc(root_dir_cache);
 
         if (!buffer) {
             printf("No memory for root dir\n");
@@ -658,7 +747,7 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
                 ATA_MASTER, ctx.root_dir_start_sector, ctx.root_dir_size_sectors, (u16*)buffer)
             != 0) {
             printf("Cannot read root dir\n");
-            kfree(buffer);
+            kmem_cache_free(root_dir_cache, buffer);
             return -1;
         }
 
@@ -682,7 +771,7 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
                 u8 sector_buffer[512];
                 if (ata_pio_read_sectors(ATA_MASTER, sector, 1, (u16*)sector_buffer) != 0) {
                     printf("Cannot read directory sector for write\n");
-                    kfree(buffer);
+                    kmem_cache_free(root_dir_cache, buffer);
                     return -1;
                 }
 
@@ -690,17 +779,17 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
 
                 if (ata_pio_write_sectors(ATA_MASTER, sector, 1, (u16*)sector_buffer) != 0) {
                     printf("Cannot write directory sector\n");
-                    kfree(buffer);
+                    kmem_cache_free(root_dir_cache, buffer);
                     return -1;
                 }
 
-                kfree(buffer);
+                kmem_cache_free(root_dir_cache, buffer);
                 printf("File cleared: %s\n", filename);
                 return 0;
             }
         }
 
-        kfree(buffer);
+        kmem_cache_free(root_dir_cache, buffer);
         return -1;
     }
 
@@ -713,7 +802,7 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
     }
 
     // Находим свободные кластеры
-    u16* cluster_chain = (u16*)kmalloc(clusters_needed * sizeof(u16));
+    u16* cluster_chain = fat12_chain_alloc(clusters_needed);
     if (!cluster_chain) {
         printf("No memory for cluster chain\n");
         return -1;
@@ -726,7 +815,7 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
         u16 free_cluster = fat12_find_free_cluster();
         if (free_cluster == 0) {
             printf("No free clusters available\n");
-            kfree(cluster_chain);
+            fat12_chain_free(cluster_chain, clusters_needed);
             return -1;
         }
 
@@ -745,6 +834,14 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
     // Последний кластер помечаем как конец цепочки
     fat12_set_fat_entry(prev_cluster, 0xFFF);
 
+    // Буфер кластера берем из кэша один раз на всю запись
+    u8* write_buffer = (u8*)kmem_cache_alloc(cluster_cache);
+    if (!write_buffer) {
+        printf("No memory for write buffer\n");
+        fat12_chain_free(cluster_chain, clusters_needed);
+        return -1;
+    }
+
     // Записываем данные в кластеры
     u32 bytes_written = 0;
     for (u32 i = 0; i < clusters_needed; i++) {
@@ -755,14 +852,6 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
             bytes_to_write = bytes_per_cluster;
         }
 
-        // Подготавливаем буфер для сектора
-        u8* write_buffer = (u8*)kmalloc(bytes_per_cluster);
-        if (!write_buffer) {
-            printf("No memory for write buffer\n");
-            kfree(cluster_chain);
-            return -1;
-        }
-
         // Копируем данные
         memcpy(write_buffer, data + bytes_written, bytes_to_write);
 
@@ -775,33 +864,33 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
         if (ata_pio_write_sectors(ATA_MASTER, sector, boot_sector.sectors_per_cluster, (u16*)write_buffer)
             != 0) {
             printf("Write error at cluster %d\n", cluster_chain[i]);
-            kfree(write_buffer);
-            kfree(cluster_chain);
+            kmem_cache_free(cluster_cache, write_buffer);
+            fat12_chain_free(cluster_chain, clusters_needed);
             return -1;
         }
 
-        kfree(write_buffer);
         bytes_written += bytes_to_write;
     }
 
+    kmem_cache_free(cluster_cache, write_buffer);
+
     // Обновляем запись в каталоге
     char formatted_name[12];
     format_filename(filename, formatted_name);
 
-    u32 buffer_size = ctx.root_dir_size_sectors * 512;
-    u8* buffer = (u8*)kmalloc(buffer_size);
+    u8* buffer = (u8*)kmem_cache_alloc(root_dir_cache);
 
     if (!buffer) {
         printf("No memory for root dir\n");
-        kfree(cluster_chain);
+        fat12_chain_free(cluster_chain, clusters_needed);
         return -1;
     }
 
     if (ata_pio_read_sectors(ATA_MASTER, ctx.root_dir_start_sector, ctx.root_dir_size_sectors, (u16*)buffer)
         != 0) {
         printf("Cannot read root dir\n");
-        kfree(buffer);
-        kfree(cluster_chain);
+        kmem_cache_free(root_dir_cache, buffer);
+        fat12_chain_free(cluster_chain, clusters_needed);
         return -1;
     }
 
@@ -829,8 +918,8 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
             u8 sector_buffer[512];
             if (ata_pio_read_sectors(ATA_MASTER, sector, 1, (u16*)sector_buffer) != 0) {
                 printf("Cannot read directory sector for write\n");
-                kfree(buffer);
-                kfree(cluster_chain);
+                kmem_cache_free(root_dir_cache, buffer);
+                fat12_chain_free(cluster_chain, clusters_needed);
                 return -1;
             }
 
@@ -838,24 +927,24 @@ int fat12_write_file(const char* filename, u8* data, u32 size) {
 
             if (ata_pio_write_sectors(ATA_MASTER, sector, 1, (u16*)sector_buffer) != 0) {
                 printf("Cannot write directory sector\n");
-                kfree(buffer);
-                kfree(cluster_chain);
+                kmem_cache_free(root_dir_cache, buffer);
+                fat12_chain_free(cluster_chain, clusters_needed);
                 return -1;
             }
 
             // Синхронизируем FAT
             fat12_sync_fat();
 
-            kfree(buffer);
-            kfree(cluster_chain);
+            kmem_cache_free(root_dir_cache, buffer);
+            fat12_chain_free(cluster_chain, clusters_needed);
 
             printf("File written: %s (%d bytes, %d clusters)\n", filename, size, clusters_needed);
             return 0;
         }
     }
 
-    kfree(buffer);
-    kfree(cluster_chain);
+    kmem_cache_free(root_dir_cache, buffer);
+    fat12_chain_free(cluster_chain, clusters_needed);
     printf("Failed to update directory entry: %s\n", filename);
     return -1;
 }
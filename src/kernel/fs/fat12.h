@@ -14,6 +14,8 @@
 
 #include "../kklibc/ctypes.h"
 
+#define FAT12_NAME_LEN 13    // "NAME.EXT" с завершающим нулем
+
 /**
  * @brief Структура загрузочного сектора FAT12
  * @details Содержит все параметры файловой системы из BPB и расширенного BPB
@@ -71,6 +73,7 @@ typedef struct {
     u32 total_clusters; /**< Общее количество кластеров в области данных */
     u8* fat_buffer; /**< Буфер для загруженной таблицы FAT */
     u32 fat_buffer_loaded; /**< Флаг загрузки таблицы FAT (0/1) */
+    u32 fat_buffer_busy; /**< Таблица FAT используется текущей операцией (shrinker ее не освобождает) */
 } fat12_context_t;
 
 /**
@@ -100,6 +103,20 @@ int fat12_find_file(const char* filename, fat12_dir_entry_t* result);
  */
 void fat12_list_root(void);
 
+/**
+ * @brief Размер корневого каталога
+ * @return Количество записей из загрузочного сектора (0, если том не смонтирован)
+ */
+int fat12_root_entries(void);
+
+/**
+ * @brief Имена файлов корневого каталога
+ * @param[out] names Массив для имен в формате "NAME.EXT"
+ * @param[in] max Размер массива
+ * @return Количество имен или -1 при ошибке чтения
+ */
+int fat12_root_names(char (*names)[FAT12_NAME_LEN], int max);
+
 /**
  * @brief Чтение содержимого файла в буфер
  * @param[in] filename Имя файла для чтения (формат 8.3)
@@ -117,7 +134,8 @@ void print_fat12_info(void);
 
 /**
  * @brief Очистка ресурсов подсистемы FAT12
- * @details Освобождает буферы и сбрасывает состояние контекста
+ * @details Записывает измененную таблицу FAT на диск. Сам буфер FAT остается в памяти
+ * до следующей операции и освобождается shrinker'ом кучи при нехватке памяти
  */
 void fat12_cleanup(void);
 
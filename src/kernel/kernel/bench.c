@@ -0,0 +1,567 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS Kernel source code
+ *  File:	kernel/bench.c
+ *  Title:	Самопроверки и микробенчмарки функций ядра
+ * Description: Такты считаются через rdtsc, результат - среднее на один вызов.
+ * ----------------------------------------------------------------------------*/
+
+#include "bench.h"
+
+#include "../cpu/idt.h"
+#include "../cpu/isr.h"
+#include "../kklibc/checksum.h"
+#include "../kklibc/math.h"
+#include "../kklibc/stdio.h"
+#include "../kklibc/stdlib.h"
+#include "sysinfo.h"
+
+#define STR_BUF_SIZE 4096
+#define STR_CHECKS 3000
+#define FMT_CHECKS 2000
+#define CRC_CHECKS 300
+#define CRC_BENCH_SIZE 4096
+
+static char str_buf[STR_BUF_SIZE + 64] __attribute__((aligned(16)));
+static char str_buf2[STR_BUF_SIZE + 64] __attribute__((aligned(16)));
+
+static volatile u32 bench_sink;    // не дает выбросить результат измеряемого вызова
+static u32 bench_seed = 12345;
+
+static inline u32 rdtsc32() {
+    u32 low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return low;
+}
+
+#define BENCH_RUN(result, expr)                                                                              \
+    do {                                                                                                     \
+        u32 start = rdtsc32();                                                                               \
+        for (u32 r = 0; r < BENCH_REPEAT; r++) {                                                             \
+            bench_sink += (u32)(expr);                                                                       \
+        }                                                                                                    \
+        (result) = (rdtsc32() - start) / BENCH_REPEAT;                                                       \
+    } while (0)
+
+static u32 bench_rand() {
+    return rand(&bench_seed);
+}
+
+static int sign(int x) {
+    return (x > 0) - (x < 0);
+}
+
+/* Побайтовые эталоны */
+
+static u32 ref_strlen(const char* s) {
+    u32 n = 0;
+    while (s[n]) {
+        n++;
+    }
+    return n;
+}
+
+static const char* ref_strchr(const char* s, char c) {
+    for (;; s++) {
+        if (*s == c) {
+            return s;
+        }
+        if (!*s) {
+            return NULL;
+        }
+    }
+}
+
+static const void* ref_memchr(const void* ptr, u8 c, u32 n) {
+    const u8* s = (const u8*)ptr;
+    for (u32 i = 0; i < n; i++) {
+        if (s[i] == c) {
+            return s + i;
+        }
+    }
+    return NULL;
+}
+
+static int ref_memcmp(const void* a, const void* b, u32 n) {
+    const u8* s1 = (const u8*)a;
+    const u8* s2 = (const u8*)b;
+    for (u32 i = 0; i < n; i++) {
+        if (s1[i] != s2[i]) {
+            return s1[i] - s2[i];
+        }
+    }
+    return 0;
+}
+
+static int ref_strcmp(const char* s1, const char* s2) {
+    while (*s1 == *s2 && *s1) {
+        s1++;
+        s2++;
+    }
+    return *s1 - *s2;
+}
+
+static const char* ref_strstr(const char* haystack, const char* needle) {
+    u32 n = ref_strlen(needle);
+    for (; *haystack; haystack++) {
+        if (ref_memcmp(haystack, needle, n) == 0) {
+            return haystack;
+        }
+    }
+    return n ? NULL : haystack;
+}
+
+// случайная строка из букв a-d (чтобы strchr/strstr находили совпадения)
+static void fill_string(char* s, u32 len) {
+    for (u32 i = 0; i < len; i++) {
+        s[i] = 'a' + bench_rand() % 4;
+    }
+    s[len] = '\0';
+}
+
+static u32 check_strings() {
+    u32 failures = 0;
+
+    for (u32 i = 0; i < STR_CHECKS; i++) {
+        u32 len = bench_rand() % 300;
+        char* s = str_buf + bench_rand() % 16;
+        char* t = str_buf2 + bench_rand() % 16;
+        char c = (bench_rand() % 8) ? 'a' + bench_rand() % 5 : '\0';
+
+        fill_string(s, len);
+        memcpy(t, s, len + 1);
+        if (len && bench_rand() % 2) {
+            t[bench_rand() % len] = 'a' + bench_rand() % 5;
+        }
+
+        u32 n = len ? bench_rand() % (len + 1) : 0;
+        u32 needle_len = 1 + bench_rand() % 4;
+        char needle[8];
+        if (len >= needle_len && bench_rand() % 2) {
+            memcpy(needle, s + bench_rand() % (len - needle_len + 1), needle_len);
+        } else {
+            fill_string(needle, needle_len);
+        }
+        needle[needle_len] = '\0';
+
+        failures += (u32)strlen(s) != ref_strlen(s);
+        failures += strchr(s, c) != ref_strchr(s, c);
+        failures += memchr(s, c, n) != ref_memchr(s, c, n);
+        failures += sign(memcmp(s, t, len)) != sign(ref_memcmp(s, t, len));
+        failures += sign(strcmp(s, t)) != sign(ref_strcmp(s, t));
+        failures += strstr(s, needle) != ref_strstr(s, needle);
+    }
+
+    return failures;
+}
+
+u32 bench_strings_selftest() {
+    u32 features = memops_get_features();
+    u32 failures = check_strings();
+
+    if (features & MEMOPS_SSE2) {
+        memops_init(features & ~MEMOPS_SSE2);
+        failures += check_strings();
+        memops_init(features);
+    }
+
+    printf(
+        "String self-test (%s): %d checks, %d failures\n",
+        (features & MEMOPS_SSE2) ? "SWAR and SSE2" : "SWAR",
+        STR_CHECKS * 6 * ((features & MEMOPS_SSE2) ? 2 : 1),
+        failures);
+    return failures;
+}
+
+// такты на вызов каждой функции для строки длины len
+static void bench_strings_row(u32 len, u32* cycles) {
+    char* s = str_buf;
+    char* t = str_buf2;
+
+    fill_string(s, len);
+    memcpy(t, s, len + 1);
+
+    BENCH_RUN(cycles[0], strlen(s));
+    BENCH_RUN(cycles[1], strchr(s, 'z'));
+    BENCH_RUN(cycles[2], memchr(s, 'z', len));
+    BENCH_RUN(cycles[3], memcmp(s, t, len));
+    BENCH_RUN(cycles[4], strcmp(s, t));
+    BENCH_RUN(cycles[5], strstr(s, "xyz"));
+}
+
+static void bench_strings_ref_row(u32 len, u32* cycles) {
+    char* s = str_buf;
+    char* t = str_buf2;
+
+    fill_string(s, len);
+    memcpy(t, s, len + 1);
+
+    BENCH_RUN(cycles[0], ref_strlen(s));
+    BENCH_RUN(cycles[1], ref_strchr(s, 'z'));
+    BENCH_RUN(cycles[2], ref_memchr(s, 'z', len));
+    BENCH_RUN(cycles[3], ref_memcmp(s, t, len));
+    BENCH_RUN(cycles[4], ref_strcmp(s, t));
+    BENCH_RUN(cycles[5], ref_strstr(s, "xyz"));
+}
+
+void bench_strings() {
+    static const char* names[6] = { "strlen", "strchr", "memchr", "memcmp", "strcmp", "strstr" };
+    static const u32 sizes[3] = { 11, 64, 1024 };
+
+    if (!(get_cpu_info()->cpu_features_edx & CPUID_EDX_TSC)) {
+        printf("No TSC, cannot measure\n");
+        return;
+    }
+
+    if (bench_strings_selftest() != 0) {
+        printf_colored("String routines are broken, skipping benchmark\n", RED_ON_BLACK);
+        return;
+    }
+
+    u32 features = memops_get_features();
+    u32 ref[3][6], swar[3][6], sse2[3][6];
+
+    for (u32 j = 0; j < 3; j++) {
+        bench_strings_ref_row(sizes[j], ref[j]);
+        memops_init(features & ~MEMOPS_SSE2);
+        bench_strings_row(sizes[j], swar[j]);
+        memops_init(features);
+        bench_strings_row(sizes[j], sse2[j]);
+    }
+
+    printf("Cycles per call: byte loop / SWAR / SSE2\n");
+    printf("%-8s", "");
+    for (u32 j = 0; j < 3; j++) {
+        printf("%20d", sizes[j]);
+    }
+    printf("\n");
+
+    for (u32 i = 0; i < 6; i++) {
+        printf("%-8s", names[i]);
+
+        for (u32 j = 0; j < 3; j++) {
+            if (features & MEMOPS_SSE2) {
+                printf("%8d/%5d/%5d", ref[j][i], swar[j][i], sse2[j][i]);
+            } else {
+                printf("%8d/%5d/%5s", ref[j][i], swar[j][i], "-");
+            }
+        }
+        printf("\n");
+    }
+}
+
+/* Форматирование чисел */
+
+// эталон: одно деление на цифру, как в прежних itoa/utoa
+static u32 ref_utoa(u64 num, char* str, u32 base) {
+    char tmp[64];
+    u32 len = 0;
+
+    do {
+        u64 rem;
+        num = udivmod64(num, base, &rem);
+        tmp[len++] = rem < 10 ? '0' + rem : 'a' + rem - 10;
+    } while (num);
+
+    for (u32 i = 0; i < len; i++) {
+        str[i] = tmp[len - 1 - i];
+    }
+    str[len] = '\0';
+    return len;
+}
+
+static u32 ref_utoa32(u32 num, char* str) {
+    char tmp[12];
+    u32 len = 0;
+
+    do {
+        tmp[len++] = '0' + num % 10;
+        num /= 10;
+    } while (num);
+
+    for (u32 i = 0; i < len; i++) {
+        str[i] = tmp[len - 1 - i];
+    }
+    str[len] = '\0';
+    return len;
+}
+
+// числа всех длин: случайные биты, обрезанные до случайной ширины
+static u64 fmt_rand64() {
+    u64 value = ((u64)bench_rand() << 32) | bench_rand();
+    u32 bits = bench_rand() % 65;
+    return bits == 64 ? value : value & (((u64)1 << bits) - 1);
+}
+
+u32 bench_format_selftest() {
+    char got[72], want[72];
+    u32 failures = 0;
+
+    for (u32 i = 0; i < FMT_CHECKS; i++) {
+        u64 value = fmt_rand64();
+        u64 divisor = fmt_rand64() | 1;
+        u64 rem;
+        u64 quot = udivmod64(value, divisor, &rem);
+
+        failures += quot * divisor + rem != value || rem >= divisor;
+        failures += value / divisor != quot || value % divisor != rem;
+
+        ref_utoa(value, want, 10);
+        failures += utoa_dec(value, got) != (u32)strlen(want) || strcmp(got, want) != 0;
+        ref_utoa(value, want, 16);
+        failures += utoa_hex(value, got) != (u32)strlen(want) || strcmp(got, want) != 0;
+        ref_utoa(value, want, 2);
+        ulltoa(value, got, 2);
+        failures += strcmp(got, want) != 0;
+
+        snprintf(got, sizeof(got), "%llu/%llx/%u", value, value, (u32)value);
+        char* end = want + ref_utoa(value, want, 10);
+        *end++ = '/';
+        end += ref_utoa(value, end, 16);
+        *end++ = '/';
+        ref_utoa((u32)value, end, 10);
+        failures += strcmp(got, want) != 0;
+
+        s64 signed_value = (s64)value;
+        s64 signed_divisor = (bench_rand() & 1) ? -(s64)(divisor >> 1 | 1) : (s64)(divisor >> 1 | 1);
+        s64 signed_quot = signed_value / signed_divisor;
+        failures += signed_quot * signed_divisor + signed_value % signed_divisor != signed_value;
+    }
+
+    printf("Format self-test: %d checks, %d failures\n", FMT_CHECKS * 8, failures);
+    return failures;
+}
+
+void bench_format() {
+    static const u32 values32[3] = { 7, 65535, 4000000000u };
+    static const u64 values64[3] = { 1000000ull, 1ull << 40, 18446744073709551615ull };
+    char buf[72];
+
+    if (!(get_cpu_info()->cpu_features_edx & CPUID_EDX_TSC)) {
+        printf("No TSC, cannot measure\n");
+        return;
+    }
+
+    if (bench_format_selftest() != 0) {
+        printf_colored("Number formatting is broken, skipping benchmark\n", RED_ON_BLACK);
+        return;
+    }
+
+    printf("Cycles per call: digit per division / lookup tables\n");
+    printf("%-20s %12s %12s\n", "value", "decimal", "hex");
+
+    for (u32 i = 0; i < 3; i++) {
+        u32 ref_dec, ref_hex, dec, hex;
+        u32 value = values32[i];
+
+        BENCH_RUN(ref_dec, ref_utoa32(value, buf));
+        BENCH_RUN(ref_hex, ref_utoa(value, buf, 16));
+        BENCH_RUN(dec, utoa_dec(value, buf));
+        BENCH_RUN(hex, utoa_hex(value, buf));
+        printf("%-20u %5u / %4u %5u / %4u\n", value, ref_dec, dec, ref_hex, hex);
+    }
+
+    for (u32 i = 0; i < 3; i++) {
+        u32 ref_dec, ref_hex, dec, hex;
+        u64 value = values64[i];
+
+        BENCH_RUN(ref_dec, ref_utoa(value, buf, 10));
+        BENCH_RUN(ref_hex, ref_utoa(value, buf, 16));
+        BENCH_RUN(dec, utoa_dec(value, buf));
+        BENCH_RUN(hex, utoa_hex(value, buf));
+        printf("%-20llu %5u / %4u %5u / %4u\n", value, ref_dec, dec, ref_hex, hex);
+    }
+
+    u32 cycles;
+    BENCH_RUN(cycles, snprintf(buf, sizeof(buf), "%u %x %llu", values32[2], values32[2], values64[2]));
+    printf("snprintf(\"%%u %%x %%llu\"): %u cycles\n", cycles);
+}
+
+/* Контрольные суммы */
+
+// эталон: по биту за шаг
+static u32 ref_crc(u32 poly, const u8* p, u32 len) {
+    u32 crc = 0xFFFFFFFF;
+
+    while (len--) {
+        crc ^= *p++;
+        for (u32 bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static u32 ref_adler32(const u8* p, u32 len) {
+    u32 a = 1, b = 0;
+
+    while (len--) {
+        a = (a + *p++) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+u32 bench_checksum_selftest() {
+    u32 features = checksum_get_features();
+    u32 failures = 0;
+    u8* buf = (u8*)str_buf;
+
+    // известные значения: "123456789" для CRC, "Wikipedia" для Adler-32
+    failures += crc32(0, "123456789", 9) != 0xCBF43926;
+    failures += adler32(1, "Wikipedia", 9) != 0x11E60398;
+    checksum_init(0);
+    failures += crc32c(0, "123456789", 9) != 0xE3069283;
+    checksum_init(features);
+    failures += crc32c(0, "123456789", 9) != 0xE3069283;
+
+    for (u32 i = 0; i < CRC_CHECKS; i++) {
+        u32 len = bench_rand() % 1500;
+        u8* p = buf + bench_rand() % 8;
+        for (u32 j = 0; j < len; j++) {
+            p[j] = bench_rand();
+        }
+
+        u32 split = len ? bench_rand() % len : 0;
+
+        failures += crc32(0, p, len) != ref_crc(0xEDB88320, p, len);
+        failures += crc32(crc32(0, p, split), p + split, len - split) != crc32(0, p, len);
+        failures += adler32(1, p, len) != ref_adler32(p, len);
+
+        u32 want = ref_crc(0x82F63B78, p, len);
+        checksum_init(0);
+        failures += crc32c(0, p, len) != want;
+        checksum_init(features);
+        failures += crc32c(crc32c(0, p, split), p + split, len - split) != want;
+    }
+
+    printf("Checksum self-test: %d checks, %d failures\n", 4 + CRC_CHECKS * 5, failures);
+    return failures;
+}
+
+void bench_checksum() {
+    u32 features = checksum_get_features();
+    u8* buf = (u8*)str_buf;
+    u32 ref, crc, crcc_table, crcc, adler;
+
+    if (!(get_cpu_info()->cpu_features_edx & CPUID_EDX_TSC)) {
+        printf("No TSC, cannot measure\n");
+        return;
+    }
+
+    if (bench_checksum_selftest() != 0) {
+        printf_colored("Checksums are broken, skipping benchmark\n", RED_ON_BLACK);
+        return;
+    }
+
+    for (u32 i = 0; i < CRC_BENCH_SIZE; i++) {
+        buf[i] = bench_rand();
+    }
+
+    BENCH_RUN(ref, ref_crc(0xEDB88320, buf, CRC_BENCH_SIZE));
+    BENCH_RUN(crc, crc32(0, buf, CRC_BENCH_SIZE));
+    checksum_init(0);
+    BENCH_RUN(crcc_table, crc32c(0, buf, CRC_BENCH_SIZE));
+    checksum_init(features);
+    BENCH_RUN(crcc, crc32c(0, buf, CRC_BENCH_SIZE));
+    BENCH_RUN(adler, adler32(1, buf, CRC_BENCH_SIZE));
+
+    u32 kb = CRC_BENCH_SIZE / 1024;
+    printf("Cycles per KB (%d KB buffer):\n", kb);
+    printf("  CRC32 bit by bit     %8u\n", ref / kb);
+    printf("  CRC32 slicing-by-8   %8u\n", crc / kb);
+    printf("  CRC32C slicing-by-8  %8u\n", crcc_table / kb);
+    if (features & CHECKSUM_SSE42) {
+        printf("  CRC32C SSE4.2        %8u\n", crcc / kb);
+    }
+    printf("  Adler-32             %8u\n", adler / kb);
+}
+
+/* Вход в прерывание */
+
+static volatile u32 irq_bench_calls = 0;
+static volatile u32 irq_bench_vector = 0;    // int_no из кадра, 0 - обработчик получил NULL
+
+static void bench_irq_handler(registers_t* r) {
+    irq_bench_calls++;
+    irq_bench_vector = r ? r->int_no : 0;
+}
+
+// прежний обработчик получал кадр по значению
+static void __attribute__((noinline)) bench_irq_byvalue(registers_t r) {
+    irq_bench_calls++;
+    irq_bench_vector = r.int_no;
+}
+
+static void bench_irq_copy(registers_t* r) {
+    bench_irq_byvalue(*r);
+}
+
+void bench_irq_legacy(registers_t r) {
+    irq_handler(&r);
+}
+
+static u32 bench_irq_raise() {
+    __asm__ volatile("int %0" : : "i"(IRQ_BENCH_VECTOR) : "memory");
+    return 0;
+}
+
+static void bench_irq_path(void (*stub)(), isr_t handler) {
+    set_idt_gate(IRQ_BENCH_VECTOR, (u32)stub);
+    register_interrupt_handler(IRQ_BENCH_VECTOR, handler);
+}
+
+// один вызов через заглушку: обработчик вызван с нужным кадром, регистры прерванного кода целы
+static u32 check_irq_path(void (*stub)(), isr_t handler, u32 vector) {
+    u32 a = 0x11111111, b = 0x22222222, c = 0x33333333, d = 0x44444444, si = 0x55555555, di = 0x66666666;
+    u32 calls = irq_bench_calls;
+
+    bench_irq_path(stub, handler);
+    irq_bench_vector = 0xFFFFFFFF;
+    __asm__ volatile("int %6"
+                     : "+a"(a), "+b"(b), "+c"(c), "+d"(d), "+S"(si), "+D"(di)
+                     : "i"(IRQ_BENCH_VECTOR)
+                     : "memory", "cc");
+
+    u32 errors = irq_bench_calls != calls + 1 || irq_bench_vector != vector;
+    errors += a != 0x11111111 || b != 0x22222222 || c != 0x33333333;
+    errors += d != 0x44444444 || si != 0x55555555 || di != 0x66666666;
+    return errors;
+}
+
+u32 bench_irq_selftest() {
+    u32 errors = 0;
+
+    errors += check_irq_path(irq_bench_frame, bench_irq_handler, IRQ_BENCH_VECTOR);
+    errors += check_irq_path(irq_bench_fast, bench_irq_handler, 0);
+    errors += check_irq_path(irq_bench_legacy, bench_irq_copy, IRQ_BENCH_VECTOR);
+    register_interrupt_handler(IRQ_BENCH_VECTOR, 0);
+
+    return errors;
+}
+
+void bench_irq() {
+    u32 legacy, frame, fast;
+
+    if (!(get_cpu_info()->cpu_features_edx & CPUID_EDX_TSC)) {
+        printf("No TSC, cannot measure\n");
+        return;
+    }
+
+    if (bench_irq_selftest() != 0) {
+        printf_colored("Interrupt entry is broken, skipping benchmark\n", RED_ON_BLACK);
+        return;
+    }
+
+    bench_irq_path(irq_bench_legacy, bench_irq_copy);
+    BENCH_RUN(legacy, bench_irq_raise());
+    bench_irq_path(irq_bench_frame, bench_irq_handler);
+    BENCH_RUN(frame, bench_irq_raise());
+    bench_irq_path(irq_bench_fast, bench_irq_handler);
+    BENCH_RUN(fast, bench_irq_raise());
+    register_interrupt_handler(IRQ_BENCH_VECTOR, 0);
+
+    printf("Cycles per interrupt (int %d, the whole irq_handler path):\n", IRQ_BENCH_VECTOR);
+    printf("  frame by value, segment reloads  %8u\n", legacy);
+    printf("  frame by pointer                 %8u\n", frame);
+    printf("  fast path, no frame              %8u\n", fast);
+}
@@ -0,0 +1,79 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS Kernel source code
+ *  File: kernel/bench.h
+ *  Title: Самопроверки и микробенчмарки функций ядра (заголовочный файл bench.c)
+ *	Description: Команда шелла bench.
+ * ----------------------------------------------------------------------------*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "../cpu/isr.h"
+#include "../kklibc/ctypes.h"
+
+#define BENCH_REPEAT 256    // вызовов на одно измерение
+
+/**
+ * @brief Проверка строковых функций kklibc против побайтовых эталонов
+ *
+ * Проверяются все варианты (SWAR и, если доступен, SSE2) на строках разной
+ * длины и с разным выравниванием.
+ *
+ * @return u32 количество расхождений
+ **/
+u32 bench_strings_selftest();
+
+/**
+ * @brief Микробенчмарк строковых функций: такты на вызов для побайтового
+ * эталона, SWAR и SSE2 на нескольких длинах
+ **/
+void bench_strings();
+
+/**
+ * @brief Проверка форматирования чисел (utoa_dec, utoa_hex, snprintf с %llu/%llx)
+ * и 64-битного деления против побайтовых эталонов
+ *
+ * @return u32 количество расхождений
+ **/
+u32 bench_format_selftest();
+
+/**
+ * @brief Микробенчмарк форматирования чисел: такты на вызов для деления
+ * на каждую цифру и для таблиц пар цифр/полубайтов
+ **/
+void bench_format();
+
+/**
+ * @brief Проверка CRC32, CRC32C (таблицы и SSE4.2) и Adler-32 на известных
+ * значениях и против побитовых эталонов
+ *
+ * @return u32 количество расхождений
+ **/
+u32 bench_checksum_selftest();
+
+/**
+ * @brief Микробенчмарк контрольных сумм: такты на килобайт
+ **/
+void bench_checksum();
+
+/**
+ * @brief Прежний вход IRQ для сравнения: кадр по значению. Вызывается из заглушки irq_bench_legacy
+ *
+ * @param r регистры
+ **/
+void bench_irq_legacy(registers_t r);
+
+/**
+ * @brief Проверка входа в прерывание через полный кадр, быстрый путь и прежнюю заглушку:
+ * обработчик вызван с нужным кадром, регистры прерванного кода сохранены
+ *
+ * @return u32 количество расхождений
+ **/
+u32 bench_irq_selftest();
+
+/**
+ * @brief Микробенчмарк входа в прерывание: такты на int через каждую заглушку
+ **/
+void bench_irq();
+
+#endif
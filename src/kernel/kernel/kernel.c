@@ -8,12 +8,17 @@
 #include "kernel.h"
 
 #include "../cpu/isr.h"
+#include "../cpu/clocksource.h"
+#include "../cpu/paging.h"
+#include "../cpu/softirq.h"
+#include "../cpu/timer.h"
 #include "../drivers/ata_pio.h"
 #include "../drivers/screen.h"
 #include "../drivers/screen_output_switch.h"
 #include "../drivers/terminal.h"
 #include "../fs/fat12.h"
 #include "../kklibc/kklibc.h"
+#include "../kklibc/pmm.h"
 #include "sysinfo.h"
 #include "utils.h"
 
@@ -21,8 +26,9 @@
 
 int shell_cursor_offset = 0;
 int shell_prompt_offset = 0;
+arena_t command_arena;
 
-void kmain() {
+void kmain(e820_map_t* memory_map) {
     // clear_screen();
 
     kprint("Launch Kintsugi OS Kernel...\n");
@@ -31,7 +37,13 @@ void kmain() {
     irq_install();
     kprint("IRQ&ISR Installed\n");
 
+    pmm_init(memory_map);
     heap_init();
+    paging_init();    // таблицы страниц берутся из кучи
+    init_apic_timer();    // регистры APIC отображаются через paging_map_region
+    clocksource_init();    // HPET из таблиц ACPI
+    arena_init(&command_arena, 0);
+    kmalloc_irq_init();
 
     detect_cpu();
     detect_memory();
@@ -54,6 +66,8 @@ void kmain() {
 
     shell_cursor_offset = get_cursor_offset();
     shell_prompt_offset = shell_cursor_offset;
+
+    softirq_idle();    // дальше ядро только обрабатывает отложенную работу IRQ
 }
 
 char** get_args(char* input) {
@@ -90,6 +104,18 @@ void user_input(char* input) {
         { .text = "qemushutdown", .hint = "Shutdown QEMU",                         .command = &shutdown_qemu            },
         { .text = "info",         .hint = "Get info",                              .command = &info_command_shell       },
         { .text = "memdump",      .hint = "Dump memory",                           .command = &mem_dump                 },
+        { .text = "heapcheck",
+         .hint = "Verify heap. Usage: heapcheck [on|off]",
+         .command = &heapcheck_command                                                                                  },
+        { .text = "memprof",      .hint = "Alloc profile. Usage: memprof [reset]", .command = &memprof_command          },
+        { .text = "memmap",       .hint = "Physical memory map",                   .command = &memmap_command           },
+        { .text = "clocksource",
+         .hint = "Time sources. Usage: clocksource [name]",
+         .command = &clocksource_command                                                                                },
+        { .text = "irqstat",      .hint = "IRQ stats. Usage: irqstat [reset]",     .command = &irqstat_command          },
+        { .text = "bench",
+         .hint = "Benchmarks. Usage: bench strings|format|crc|irq",
+         .command = &bench_command                                                                                      },
         { .text = "malloc",       .hint = "Alloc memory. Usage: malloc <size>",    .command = &kmalloc_command          },
         { .text = "free",         .hint = "Free memory. Usage: free <address>",    .command = &free_command             },
         { .text = "echo",         .hint = "Echo an text",                          .command = &echo_command             },
@@ -103,8 +129,10 @@ void user_input(char* input) {
          .hint = "Binary power. Usage: binpow <base> <exponent>",
          .command = &binary_pow_command                                                                                 },
         { .text = "ls",           .hint = "List files",                            .command = &ls_command               },
+        { .text = "find",         .hint = "Fuzzy file search. Usage: find <q>",    .command = &find_command             },
         { .text = "cat",          .hint = "Show file content",                     .command = &cat_command              },
-        { .text = "load",         .hint = "Load file to memory",                   .command = &load_command             },
+        { .text = "load",         .hint = "Load: load <file> [addr] [-c crc32]",   .command = &load_command             },
+        { .text = "crc",          .hint = "Checksums. Usage: crc <file>",          .command = &crc_command              },
         { .text = "fat12info",    .hint = "Print fat12 fs info",                   .command = &print_fat12_info_command },
         { .text = "create",
          .hint = "Create empty file. Usage: create <filename>",
@@ -119,11 +147,14 @@ void user_input(char* input) {
 
     char** args = get_args(input);
 
+    terminal_begin_batch();    // вывод команды перерисовывается один раз, в terminal_flush ниже
+
     const int commands_length = sizeof(commands) / sizeof(commands[0]);
 
     for (int i = 0; i < commands_length; ++i) {
         if (strcmp(input, commands[i].text) == 0) {
             commands[i].command(args);
+            arena_reset(&command_arena);    // вся временная память команды - за O(1)
             executed = 1;
             break;
         }
@@ -139,10 +170,33 @@ void user_input(char* input) {
 
     if (executed == 0 && strcmp(input, "") != 0) {
         printf_colored("Invalid command: %s", RED_ON_BLACK, input);
+
+        // подсказка: лучшая по нечеткому поиску команда ("mprof" -> memprof)
+        fuzzy_pattern_t pattern;
+        const char* names[sizeof(commands) / sizeof(commands[0])];
+        int scores[sizeof(commands) / sizeof(commands[0])];
+
+        for (int i = 0; i < commands_length; ++i) {
+            names[i] = commands[i].text;
+        }
+
+        if (fuzzy_compile(&pattern, input) && fuzzy_match_batch(&pattern, names, commands_length, scores)) {
+            int best = 0;
+            for (int i = 1; i < commands_length; ++i) {
+                if (scores[i] > scores[best]) {
+                    best = i;
+                }
+            }
+            printf("\nDid you mean: %s?", names[best]);
+        }
     }
 
+    // команда могла опустошить магазины kmalloc_irq - пополняем их между командами
+    kmalloc_irq_refill();
+
     // Вывод строки шелла
     kprint("\n!#> ");
+    terminal_flush();
 
     shell_cursor_offset = get_cursor_offset();
     shell_prompt_offset = shell_cursor_offset;
@@ -1,6 +1,8 @@
 #ifndef KERNEL_H
 #define KERNEL_H
 
+#include "../kklibc/arena.h"
+
 /**
  * @brief Обработка пользовательского ввода в шелле
  *
@@ -10,5 +12,6 @@ void user_input(char* input);
 
 extern int shell_cursor_offset;
 extern int shell_prompt_offset;
+extern arena_t command_arena;    // временная память команды шелла, сбрасывается после ее выполнения
 
 #endif
@@ -1,16 +1,35 @@
 #include "sysinfo.h"
 
+#include "../cpu/timer.h"
+#include "../kklibc/checksum.h"
 #include "../kklibc/mem.h"
+#include "../kklibc/pmm.h"
 #include "../kklibc/stdio.h"
 #include "../kklibc/stdlib.h"
 
 static system_info_t sys_info;
 
+#define CR0_MP 0x02
+#define CR0_EM 0x04
+#define CR4_OSFXSR 0x200
+#define CR4_OSXMMEXCPT 0x400
+
+// разрешение инструкций SSE (без этого они вызывают #UD)
+static void enable_sse() {
+    u32 cr0, cr4;
+
+    __asm__ volatile("mov %%cr0, %0" : "=r"(cr0));
+    __asm__ volatile("mov %0, %%cr0" : : "r"((cr0 & ~CR0_EM) | CR0_MP));
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    __asm__ volatile("mov %0, %%cr4" : : "r"(cr4 | CR4_OSFXSR | CR4_OSXMMEXCPT));
+}
+
 void detect_cpu(void) {
     u32 eax, ebx, ecx, edx;
     char vendor[13];
 
     __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(0));
+    sys_info.cpu_max_leaf = eax;
     *((u32*)vendor) = ebx;
     *((u32*)(vendor + 4)) = edx;
     *((u32*)(vendor + 8)) = ecx;
@@ -19,28 +38,70 @@ void detect_cpu(void) {
 
     __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1));
     sys_info.cpu_cores = 1;
+    sys_info.cpu_speed = timer_tsc_khz() / 1000;
+    sys_info.cpu_features_ecx = ecx;
+    sys_info.cpu_features_edx = edx;
+
+    sys_info.cpu_ext_features_ebx = 0;
+    if (sys_info.cpu_max_leaf >= 7) {
+        __asm__ volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(7), "c"(0));
+        sys_info.cpu_ext_features_ebx = ebx;
+    }
+
     printf("CPU detected: %s\n", vendor);
+
+    // варианты memcpy/memset под этот процессор
+    u32 memops = 0;
+    if (sys_info.cpu_ext_features_ebx & CPUID_7_EBX_ERMSB) {
+        memops |= MEMOPS_ERMSB;
+    }
+    if (sys_info.cpu_features_edx & CPUID_EDX_SSE2) {
+        memops |= MEMOPS_NT;
+
+        u32 sse_needed = CPUID_EDX_FXSR | CPUID_EDX_SSE;
+        if ((sys_info.cpu_features_edx & sse_needed) == sse_needed) {
+            enable_sse();
+            memops |= MEMOPS_SSE2;
+        }
+    }
+    memops_init(memops);
+
+    printf(
+        "memcpy/memset: %s%s; strlen/memchr: SWAR%s\n",
+        (memops & MEMOPS_ERMSB) ? "rep movsb (ERMSB)" : "rep movsd",
+        (memops & MEMOPS_NT) ? ", movnti for large blocks" : "",
+        (memops & MEMOPS_SSE2) ? " + SSE2" : "");
+
+    checksum_init((sys_info.cpu_features_ecx & CPUID_ECX_SSE42) ? CHECKSUM_SSE42 : 0);
+    printf("CRC32C: %s\n", (checksum_get_features() & CHECKSUM_SSE42) ? "SSE4.2 crc32" : "slicing-by-8 tables");
 }
 
 void detect_memory() {
     meminfo_t info = get_meminfo();
-    sys_info.total_memory = HEAP_START + HEAP_SIZE;
-    sys_info.used_memory = info.total_used + (HEAP_START - 0x1000);
-    sys_info.free_memory = info.total_free;
+    pmminfo_t pmm = pmm_get_info();
+
+    // свободна память в свободных фреймах и в свободных блоках кучи
+    sys_info.total_memory = pmm.total_memory;
+    sys_info.free_memory = pmm.free_memory + info.total_free;
+    sys_info.used_memory = sys_info.total_memory - sys_info.free_memory;
 
-    sys_info.kernel_memory = HEAP_START - 0x1000;
+    sys_info.kernel_memory = pmm.reserved_memory;
     sys_info.heap_size = info.heap_size;
     sys_info.heap_used = info.total_used;
     sys_info.heap_free = info.total_free;
 
     printf(
         "Memory detected: total=%d; used=%d; free=%d\n",
-        HEAP_START + HEAP_SIZE,
-        info.total_used + (HEAP_START - 0x1000),
-        info.total_free);
+        sys_info.total_memory,
+        sys_info.used_memory,
+        sys_info.free_memory);
 }
 
 system_info_t* get_system_info() {
     detect_memory();
     return &sys_info;
 }
+
+const system_info_t* get_cpu_info() {
+    return &sys_info;
+}
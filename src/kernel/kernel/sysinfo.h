@@ -18,8 +18,19 @@ typedef struct {
     u32 cpu_speed;    // в MHz
     char cpu_vendor[13];
     u8 cpu_cores;
+    u32 cpu_max_leaf;    // старший поддерживаемый лист CPUID
+    u32 cpu_features_ecx;    // CPUID.01H:ECX
+    u32 cpu_features_edx;    // CPUID.01H:EDX
+    u32 cpu_ext_features_ebx;    // CPUID.07H:EBX (0, если лист 7 не поддерживается)
 } system_info_t;
 
+#define CPUID_ECX_SSE42 (1 << 20)
+#define CPUID_EDX_TSC (1 << 4)
+#define CPUID_EDX_FXSR (1 << 24)
+#define CPUID_EDX_SSE (1 << 25)
+#define CPUID_EDX_SSE2 (1 << 26)
+#define CPUID_7_EBX_ERMSB (1 << 9)
+
 // Функции для получения информации
 
 /**
@@ -41,4 +52,11 @@ void detect_memory(void);
  **/
 system_info_t* get_system_info();
 
+/**
+ * @brief Сведения о процессоре, собранные detect_cpu (без пересчета памяти)
+ *
+ * @return const system_info_t*
+ **/
+const system_info_t* get_cpu_info();
+
 #endif
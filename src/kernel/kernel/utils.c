@@ -7,17 +7,30 @@
 
 #include "utils.h"
 
+#include "../cpu/clocksource.h"
+#include "../cpu/irqstat.h"
+#include "../cpu/paging.h"
 #include "../cpu/ports.h"
+#include "../cpu/softirq.h"
+#include "../cpu/timer.h"
+#include "../drivers/keyboard.h"
 #include "../drivers/screen.h"
+#include "../drivers/terminal.h"
 #include "../fs/fat12.h"
+#include "../kklibc/checksum.h"
 #include "../kklibc/ctypes.h"
 #include "../kklibc/kklibc.h"
 #include "../kklibc/math.h"
 #include "../kklibc/mem.h"
+#include "../kklibc/memprof.h"
+#include "../kklibc/pmm.h"
 #include "../kklibc/stdio.h"
 #include "../kklibc/stdlib.h"
+#include "bench.h"
+#include "kernel.h"
 #include "sysinfo.h"
 
+
 void binary_pow_command(char** args) {
     if (!args[0] || !args[1]) {
         kprint("binpow usage: binpow <base> <exponent>");
@@ -83,6 +96,7 @@ void halt_cpu(char** args) {
     kprint_colored("Halted CPU Blue Screen\n", BLUE_ON_WHITE);
     kprint_colored("CPU is halted.\n\n", BLUE_ON_WHITE);
     kprint_colored("__asm__ volatile(\"hlt\")", BLUE_ON_WHITE);
+    terminal_flush();    // из обработчика клавиатуры уже не вернемся
 
     __asm__ volatile("hlt");
 }
@@ -90,7 +104,15 @@ void halt_cpu(char** args) {
 void sysinfo_command() {
     system_info_t* info = get_system_info();
 
-    printf("CPU: %s, %d core(s)\n", info->cpu_vendor, info->cpu_cores);
+    u64 uptime_ms = div64_u32(timer_monotonic_ns(), NS_PER_MS, NULL);
+
+    printf("CPU: %s, %d core(s), %d MHz\n", info->cpu_vendor, info->cpu_cores, info->cpu_speed);
+    printf("Uptime: %llu.%03u s, timer interrupts: %u\n", uptime_ms / 1000, (u32)(uptime_ms % 1000), tick);
+    printf("Timer: %s\n", timer_event_source());
+    softirq_dump();
+    if (keyboard_dropped()) {
+        printf_colored("Keyboard: %u scancodes dropped\n", RED_ON_BLACK, keyboard_dropped());
+    }
     printf(
         "Memory: %d KB total, %d KB free, %d KB used\n",
         info->total_memory / KB,
@@ -119,6 +141,81 @@ void info_command_shell(char** args) {
 
 void mem_dump(char** args) {
     kmemdump();
+    kmem_cache_dump();
+    arena_dump(&command_arena, "command");
+    kmalloc_irq_dump();
+}
+
+void heapcheck_command(char** args) {
+    if (args[0] && strcmp(args[0], "on") == 0) {
+        heap_set_selfcheck(1);
+        kprint("Heap self-check after every free: on\n");
+    } else if (args[0] && strcmp(args[0], "off") == 0) {
+        heap_set_selfcheck(0);
+        kprint("Heap self-check after every free: off\n");
+    }
+
+    int errors = kmemverify();
+    if (errors == 0) {
+        kprint("Heap is consistent");
+    } else {
+        printf_colored("Heap check failed: %d error(s)", RED_ON_BLACK, errors);
+    }
+}
+
+void memprof_command(char** args) {
+    if (args[0] && strcmp(args[0], "reset") == 0) {
+        memprof_reset(0);
+        kprint("Allocation profile counters reset\n");
+    }
+
+    memprof_dump();
+}
+
+void memmap_command(char** args) {
+    pmm_dump();
+    paging_dump();
+}
+
+void clocksource_command(char** args) {
+    if (args[0] && !clocksource_select(args[0])) {
+        printf("Unknown clocksource: %s\n", args[0]);
+    }
+
+    printf("Clocksources (current: %s, now %llu ns):\n", clocksource_current()->name, clock_now_ns());
+    clocksource_dump();
+}
+
+void irqstat_command(char** args) {
+    if (args[0] && strcmp(args[0], "reset") == 0) {
+        irqstat_reset();
+        kprint("Interrupt statistics reset\n");
+        return;
+    }
+
+    kprint("Interrupt handler time, TSC cycles:\n");
+    irqstat_dump();
+}
+
+void bench_command(char** args) {
+    if (args[0] && strcmp(args[0], "strings") == 0) {
+        bench_strings();
+        return;
+    }
+    if (args[0] && strcmp(args[0], "format") == 0) {
+        bench_format();
+        return;
+    }
+    if (args[0] && strcmp(args[0], "crc") == 0) {
+        bench_checksum();
+        return;
+    }
+    if (args[0] && strcmp(args[0], "irq") == 0) {
+        bench_irq();
+        return;
+    }
+
+    kprint("bench usage: bench strings|format|crc|irq");
 }
 
 void echo_command(char** args) {
@@ -151,11 +248,15 @@ void kmalloc_command(char** args) {
 
     int size = strtoint(args[0]);
     void* ptr = (void*)kmalloc(size);
+    if (!ptr) {
+        printf_colored("Cannot allocate %d bytes", RED_ON_BLACK, size);
+        return;
+    }
 
     char buf1[32] = "";
     char buf2[32] = "";
     hex_to_ascii((int)ptr, buf1);
-    hex_to_ascii((int)ptr - sizeof(mem_block_t), buf2);
+    hex_to_ascii((int)ptr - BLOCK_HEADER_SIZE, buf2);
 
     printf("Allocate %d bytes.\nPointer: %s (block header at %s)\n", size, buf1, buf2);
 }
@@ -165,6 +266,65 @@ void ls_command(char** args) {
     fat12_cleanup();
 }
 
+void find_command(char** args) {
+    if (!args[0]) {
+        kprint("Usage: find <query>\n");
+        return;
+    }
+
+    fuzzy_pattern_t pattern;
+    if (!fuzzy_compile(&pattern, args[0])) {
+        printf("Query is too long (max %d chars)\n", FUZZY_MAX_QUERY);
+        return;
+    }
+
+    // файлов в корне не больше, чем записей корневого каталога в загрузочном секторе
+    int max_files = fat12_root_entries();
+    if (max_files == 0) {
+        printf("Cannot read root dir\n");
+        return;
+    }
+
+    char(*names)[FAT12_NAME_LEN] = arena_alloc(&command_arena, max_files * FAT12_NAME_LEN);
+    const char** texts = (const char**)arena_alloc(&command_arena, max_files * sizeof(char*));
+    int* scores = (int*)arena_alloc(&command_arena, max_files * sizeof(int));
+    if (!names || !texts || !scores) {
+        return;
+    }
+
+    int count = fat12_root_names(names, max_files);
+    fat12_cleanup();
+    if (count < 0) {
+        printf("Cannot read root dir\n");
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        texts[i] = names[i];
+    }
+
+    if (fuzzy_match_batch(&pattern, texts, count, scores) == 0) {
+        printf("No files match \"%s\"\n", args[0]);
+        return;
+    }
+
+    // выборка по убыванию оценки
+    for (;;) {
+        int best = -1;
+        for (int i = 0; i < count; i++) {
+            if (scores[i] > 0 && (best < 0 || scores[i] > scores[best])) {
+                best = i;
+            }
+        }
+        if (best < 0) {
+            break;
+        }
+
+        printf("%-12s  score %d\n", texts[best], scores[best]);
+        scores[best] = 0;
+    }
+}
+
 void cat_command(char** args) {
     if (!args[0]) {
         kprint("Usage: cat <filename>\n");
@@ -177,7 +337,7 @@ void cat_command(char** args) {
         return;
     }
 
-    u8* buffer = (u8*)kmalloc(entry.file_size + 1);
+    u8* buffer = (u8*)arena_alloc(&command_arena, entry.file_size + 1);
     if (!buffer) {
         return;
     }
@@ -187,7 +347,6 @@ void cat_command(char** args) {
         printf("%s", buffer);
     }
 
-    kfree(buffer);
     fat12_cleanup();
 }
 
@@ -197,7 +356,7 @@ void print_fat12_info_command(char** args) {
 
 void load_command(char** args) {
     if (!args[0]) {
-        kprint("Usage: load <filename> <address>\n");
+        kprint("Usage: load <filename> [address] [-c crc32]\n");
         return;
     }
 
@@ -209,24 +368,86 @@ void load_command(char** args) {
 
     printf("File size: %d bytes\n", entry.file_size);
 
+    // адрес и ожидаемый CRC32 (-c) независимы и идут в любом порядке
     u32 address = 0x100000;
-    if (args[1]) {
-        address = hex_strtoint(args[1]);
+    char* crc_arg = NULL;
+    for (int i = 1; args[i]; i++) {
+        if (strcmp(args[i], "-c") != 0) {
+            address = hex_strtoint(args[i]);
+            continue;
+        }
+        crc_arg = args[++i];
+        if (!crc_arg) {
+            kprint("Usage: load <filename> [address] [-c crc32]\n");
+            return;
+        }
     }
 
-    u8* buffer = (u8*)kmalloc(entry.file_size);
+    u8* buffer = (u8*)arena_alloc(&command_arena, entry.file_size);
     if (!buffer) {
         printf("No memory for file (%d bytes needed)\n", entry.file_size);
         kmemdump();
         return;
     }
 
+    if (fat12_read_file(args[0], buffer) != 0) {
+        fat12_cleanup();
+        return;
+    }
+    fat12_cleanup();
+
+    // проверка по ожидаемому CRC32 (как выводит crc): файл до копирования, память после
+    if (crc_arg) {
+        u32 expected = (u32)hex_strtoint(crc_arg);
+        u32 actual = crc32(0, buffer, entry.file_size);
+
+        if (actual != expected) {
+            printf_colored(
+                "CRC32 mismatch: file 0x%x, expected 0x%x. Not loaded\n",
+                RED_ON_BLACK,
+                actual,
+                expected);
+            return;
+        }
+    }
+
+    memcpy((void*)address, buffer, entry.file_size);
+
+    if (crc_arg) {
+        if (memcmp((void*)address, buffer, entry.file_size) != 0) {
+            printf_colored("Verify failed: memory at 0x%x differs from the file\n", RED_ON_BLACK, address);
+            return;
+        }
+        printf("CRC32 verified\n");
+    }
+
+    printf("Loaded to 0x%x\n", address);
+}
+
+void crc_command(char** args) {
+    if (!args[0]) {
+        kprint("Usage: crc <filename>\n");
+        return;
+    }
+
+    fat12_dir_entry_t entry;
+    if (!fat12_find_file(args[0], &entry)) {
+        printf("File not found: %s\n", args[0]);
+        return;
+    }
+
+    u8* buffer = (u8*)arena_alloc(&command_arena, entry.file_size + 1);
+    if (!buffer) {
+        return;
+    }
+
     if (fat12_read_file(args[0], buffer) == 0) {
-        memcpy((void*)address, buffer, entry.file_size);
-        printf("Loaded to 0x%x\n", address);
+        printf("%s: %u bytes\n", args[0], entry.file_size);
+        printf("  CRC32    0x%08x\n", crc32(0, buffer, entry.file_size));
+        printf("  CRC32C   0x%08x\n", crc32c(0, buffer, entry.file_size));
+        printf("  Adler-32 0x%08x\n", adler32(1, buffer, entry.file_size));
     }
 
-    kfree(buffer);
     fat12_cleanup();
 }
 
@@ -280,7 +501,7 @@ void write_command(char** args) {
     }
 
     u32 size = strlen(text);
-    u8* buffer = (u8*)kmalloc(size);
+    u8* buffer = (u8*)arena_alloc(&command_arena, size);
 
     if (!buffer) {
         printf("No memory for write buffer\n");
@@ -295,6 +516,5 @@ void write_command(char** args) {
         printf("Failed to write to file: %s\n", args[0]);
     }
 
-    kfree(buffer);
     fat12_cleanup();
 }
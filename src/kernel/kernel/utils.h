@@ -64,6 +64,48 @@ void info_command_shell(char** args);
  **/
 void mem_dump(char** args);
 
+/**
+ * @brief Команда проверки целостности кучи (heapcheck [on|off])
+ *
+ * @param args аргументы
+ **/
+void heapcheck_command(char** args);
+
+/**
+ * @brief Команда вывода профиля выделений памяти по местам вызова (memprof [reset])
+ *
+ * @param args аргументы
+ **/
+void memprof_command(char** args);
+
+/**
+ * @brief Команда вывода карты физической памяти E820 и состояния страничной адресации
+ *
+ * @param args аргументы
+ **/
+void memmap_command(char** args);
+
+/**
+ * @brief Источники времени: рейтинг, разрешение, цена чтения; clocksource <name> переключает
+ *
+ * @param args аргументы
+ **/
+void clocksource_command(char** args);
+
+/**
+ * @brief Статистика прерываний по векторам и самое долгое окно без прерываний (irqstat [reset])
+ *
+ * @param args аргументы
+ **/
+void irqstat_command(char** args);
+
+/**
+ * @brief Команда самопроверок и микробенчмарков (bench strings|format|crc|irq)
+ *
+ * @param args аргументы
+ **/
+void bench_command(char** args);
+
 /**
  * @brief Команда очистки
  *
@@ -94,10 +136,24 @@ void free_command(char** args);
 
 void ls_command(char** args);
 
+/**
+ * @brief Команда нечеткого поиска файлов в корневом каталоге (find <query>)
+ *
+ * @param args аргументы
+ **/
+void find_command(char** args);
+
 void cat_command(char** args);
 
 void load_command(char** args);
 
+/**
+ * @brief Команда подсчета контрольных сумм файла: CRC32, CRC32C, Adler-32 (crc <file>)
+ *
+ * @param args аргументы
+ **/
+void crc_command(char** args);
+
 void print_fat12_info_command(char** args);
 
 /* -------------------------------------------------------------------------- */
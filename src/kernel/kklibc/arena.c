@@ -0,0 +1,118 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS KKLIBC source code
+ *  File: kklibc/arena.c
+ *  Title: Арена (bump-pointer аллокатор)
+ *	Description: Основной кусок арены выделяется один раз и переиспользуется
+ *	после каждого arena_reset, поэтому короткоживущие буферы не дробят кучу.
+ * ----------------------------------------------------------------------------*/
+
+#include "arena.h"
+
+#include "mem.h"
+#include "stdio.h"
+
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define CHUNK_DATA(chunk) ((u8*)(chunk) + sizeof(arena_chunk_t))
+
+static arena_chunk_t* arena_chunk_new(u32 size) {
+    arena_chunk_t* chunk = (arena_chunk_t*)kmalloc(sizeof(arena_chunk_t) + size);
+    if (chunk) {
+        chunk->next = NULL;
+        chunk->size = size;
+        chunk->used = 0;
+    }
+    return chunk;
+}
+
+static void* arena_take(arena_t* arena, arena_chunk_t* chunk, u32 size) {
+    void* ptr = CHUNK_DATA(chunk) + chunk->used;
+
+    chunk->used += size;
+    arena->used += size;
+    arena->alloc_count++;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+
+    return ptr;
+}
+
+void arena_init(arena_t* arena, u32 chunk_size) {
+    arena->first = NULL;
+    arena->extra = NULL;
+    arena->chunk_size = ARENA_ROUND(chunk_size ? chunk_size : ARENA_DEFAULT_CHUNK);
+    arena->used = 0;
+    arena->peak = 0;
+    arena->alloc_count = 0;
+    arena->reset_count = 0;
+}
+
+void* arena_alloc(arena_t* arena, u32 size) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    size = ARENA_ROUND(size);
+
+    if (!arena->first) {
+        arena->first = arena_chunk_new(arena->chunk_size);
+        if (!arena->first) {
+            return NULL;
+        }
+    }
+
+    // быстрый путь: сдвиг указателя в основном куске
+    arena_chunk_t* chunk = arena->first;
+    if (chunk->size - chunk->used >= size) {
+        return arena_take(arena, chunk, size);
+    }
+
+    // затем - в последнем дополнительном куске
+    chunk = arena->extra;
+    if (chunk && chunk->size - chunk->used >= size) {
+        return arena_take(arena, chunk, size);
+    }
+
+    // крупный запрос получает кусок целиком, мелкие - новый кусок обычного размера
+    chunk = arena_chunk_new(size > arena->chunk_size / 2 ? size : arena->chunk_size);
+    if (!chunk) {
+        return NULL;
+    }
+
+    chunk->next = arena->extra;
+    arena->extra = chunk;
+
+    return arena_take(arena, chunk, size);
+}
+
+void arena_reset(arena_t* arena) {
+    while (arena->extra) {
+        arena_chunk_t* next = arena->extra->next;
+        kfree(arena->extra);
+        arena->extra = next;
+    }
+
+    if (arena->first) {
+        arena->first->used = 0;
+    }
+    arena->used = 0;
+    arena->reset_count++;
+}
+
+void arena_destroy(arena_t* arena) {
+    arena_reset(arena);
+
+    kfree(arena->first);
+    arena->first = NULL;
+}
+
+void arena_dump(arena_t* arena, char* name) {
+    printf(
+        "Arena %s: chunk %d bytes, used %d, peak %d, allocs %d, resets %d\n",
+        name,
+        arena->chunk_size,
+        arena->used,
+        arena->peak,
+        arena->alloc_count,
+        arena->reset_count);
+}
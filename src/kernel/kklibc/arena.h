@@ -0,0 +1,85 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS C Libraries source code
+ *  File: libc/arena.h
+ *  Title: Арена (bump-pointer аллокатор) для короткоживущих выделений (заголовочный файл arena.c)
+ *	Description: Память выдается сдвигом указателя внутри куска из kmalloc и
+ *	освобождается вся сразу через arena_reset.
+ * ----------------------------------------------------------------------------*/
+
+#ifndef KKLIBC_ARENA_H
+#define KKLIBC_ARENA_H
+
+#include "ctypes.h"
+
+#define ARENA_ALIGN 16    // как у kmalloc
+#define ARENA_DEFAULT_CHUNK 16384
+
+/**
+ * @brief Кусок памяти арены (заголовок лежит в начале куска)
+ *
+ **/
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    u32 size;    // размер области данных
+    u32 used;
+    u32 reserved;    // выравнивание заголовка до ARENA_ALIGN
+} arena_chunk_t;
+
+/**
+ * @brief Арена
+ *
+ **/
+typedef struct arena {
+    arena_chunk_t* first;    // основной кусок, переживает arena_reset
+    arena_chunk_t* extra;    // дополнительные куски (переполнение и крупные запросы), освобождаются в arena_reset
+    u32 chunk_size;
+    u32 used;    // выдано байт с последнего arena_reset
+    u32 peak;    // максимум used за все время
+    u32 alloc_count;
+    u32 reset_count;
+} arena_t;
+
+/**
+ * @brief Инициализация арены (память выделяется при первом arena_alloc)
+ *
+ * @param arena арена
+ * @param chunk_size размер основного куска (0 - ARENA_DEFAULT_CHUNK)
+ **/
+void arena_init(arena_t* arena, u32 chunk_size);
+
+/**
+ * @brief Выделение памяти из арены
+ *
+ * Освобождать результат не нужно: вся память арены возвращается в arena_reset.
+ *
+ * @param arena арена
+ * @param size размер
+ * @return void* память, выровненная на ARENA_ALIGN, или NULL
+ **/
+void* arena_alloc(arena_t* arena, u32 size);
+
+/**
+ * @brief Освобождение всех выделений арены
+ *
+ * Основной кусок остается за ареной (O(1)), дополнительные возвращаются в кучу.
+ *
+ * @param arena арена
+ **/
+void arena_reset(arena_t* arena);
+
+/**
+ * @brief Освобождение всей памяти арены, включая основной кусок
+ *
+ * @param arena арена
+ **/
+void arena_destroy(arena_t* arena);
+
+/**
+ * @brief Вывод статистики арены
+ *
+ * @param arena арена
+ * @param name имя арены
+ **/
+void arena_dump(arena_t* arena, char* name);
+
+#endif
@@ -0,0 +1,154 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS KKLIBC source code
+ *  File: kklibc/checksum.c
+ *  Title: Контрольные суммы CRC32, CRC32C и Adler-32
+ *	Description: CRC считается по 8 байт за шаг (slicing-by-8): таблица k дает
+ *	вклад байта, за которым следуют еще k байт. Таблицы строятся в checksum_init,
+ *	чтобы не раздувать образ ядра. Инструкция crc32 из SSE4.2 реализует только
+ *	полином Castagnoli, поэтому ускоряет CRC32C, а CRC32 всегда табличный.
+ * ----------------------------------------------------------------------------*/
+
+#include "checksum.h"
+
+#define CRC32_POLY 0xEDB88320    // 0x04C11DB7 в отраженном виде
+#define CRC32C_POLY 0x82F63B78    // 0x1EDC6F41 в отраженном виде
+
+#define ADLER_MOD 65521
+#define ADLER_NMAX 5552    // столько байт можно сложить без переполнения u32 до взятия остатка
+
+static u32 crc32_table[8][256];
+static u32 crc32c_table[8][256];
+static u8 tables_ready = 0;
+static u32 checksum_features = 0;
+
+static void build_table(u32 table[8][256], u32 poly) {
+    for (u32 i = 0; i < 256; i++) {
+        u32 crc = i;
+        for (u32 bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ poly : crc >> 1;
+        }
+        table[0][i] = crc;
+    }
+
+    for (u32 i = 0; i < 256; i++) {
+        for (u32 k = 1; k < 8; k++) {
+            table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+        }
+    }
+}
+
+void checksum_init(u32 features) {
+    if (!tables_ready) {
+        build_table(crc32_table, CRC32_POLY);
+        build_table(crc32c_table, CRC32C_POLY);
+        tables_ready = 1;
+    }
+    checksum_features = features;
+}
+
+u32 checksum_get_features() {
+    return checksum_features;
+}
+
+static u32 crc_slice8(u32 table[8][256], u32 crc, const u8* p, u32 len) {
+    while (len && ((u32)p & 3)) {
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+
+    while (len >= 8) {
+        u32 one = *(const u32*)p ^ crc;
+        u32 two = *(const u32*)(p + 4);
+
+        crc = table[7][one & 0xFF] ^ table[6][(one >> 8) & 0xFF] ^ table[5][(one >> 16) & 0xFF]
+              ^ table[4][one >> 24] ^ table[3][two & 0xFF] ^ table[2][(two >> 8) & 0xFF]
+              ^ table[1][(two >> 16) & 0xFF] ^ table[0][two >> 24];
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        crc = table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static u32 crc32c_sse42(u32 crc, const u8* p, u32 len) {
+    while (len && ((u32)p & 3)) {
+        __asm__("crc32b %1, %0" : "+r"(crc) : "qm"(*p));
+        p++;
+        len--;
+    }
+
+    // основной цикл целиком в asm: на сборке без оптимизаций цикл на C стоил бы больше самой инструкции
+    u32 words = len / 4;
+    if (words) {
+        __asm__ volatile("1: crc32l (%1), %0\n\t"
+                         "add $4, %1\n\t"
+                         "dec %2\n\t"
+                         "jnz 1b"
+                         : "+r"(crc), "+r"(p), "+r"(words)
+                         :
+                         : "cc", "memory");
+    }
+
+    for (len &= 3; len; len--) {
+        __asm__("crc32b %1, %0" : "+r"(crc) : "qm"(*p));
+        p++;
+    }
+
+    return crc;
+}
+
+u32 crc32(u32 crc, const void* data, u32 len) {
+    if (!tables_ready) {
+        checksum_init(checksum_features);
+    }
+    return ~crc_slice8(crc32_table, ~crc, (const u8*)data, len);
+}
+
+u32 crc32c(u32 crc, const void* data, u32 len) {
+    if (checksum_features & CHECKSUM_SSE42) {
+        return ~crc32c_sse42(~crc, (const u8*)data, len);
+    }
+
+    if (!tables_ready) {
+        checksum_init(checksum_features);
+    }
+    return ~crc_slice8(crc32c_table, ~crc, (const u8*)data, len);
+}
+
+u32 adler32(u32 adler, const void* data, u32 len) {
+    const u8* p = (const u8*)data;
+    u32 a = adler & 0xFFFF;
+    u32 b = adler >> 16;
+
+    // остаток берется раз в ADLER_NMAX байт, а не на каждом байте
+    while (len) {
+        u32 chunk = len < ADLER_NMAX ? len : ADLER_NMAX;
+        len -= chunk;
+
+        while (chunk >= 4) {
+            a += p[0];
+            b += a;
+            a += p[1];
+            b += a;
+            a += p[2];
+            b += a;
+            a += p[3];
+            b += a;
+            p += 4;
+            chunk -= 4;
+        }
+        while (chunk--) {
+            a += *p++;
+            b += a;
+        }
+
+        a %= ADLER_MOD;
+        b %= ADLER_MOD;
+    }
+
+    return (b << 16) | a;
+}
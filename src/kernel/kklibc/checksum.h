@@ -0,0 +1,59 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS C Libraries source code
+ *  File: libc/checksum.h
+ *  Title: Контрольные суммы CRC32, CRC32C и Adler-32 (заголовочный файл checksum.c)
+ *	Description: Табличный CRC (slicing-by-8), инструкция crc32 из SSE4.2 для CRC32C.
+ * ----------------------------------------------------------------------------*/
+
+#ifndef KKLIBC_CHECKSUM_H
+#define KKLIBC_CHECKSUM_H
+
+#include "ctypes.h"
+
+#define CHECKSUM_SSE42 0x01    // инструкция crc32 (CPUID.01H:ECX.SSE4_2)
+
+/**
+ * @brief Построение таблиц и выбор варианта CRC32C
+ *
+ * @param features флаги CHECKSUM_*
+ **/
+void checksum_init(u32 features);
+
+/**
+ * @brief Флаги CHECKSUM_*, выбранные checksum_init
+ *
+ * @return u32
+ **/
+u32 checksum_get_features();
+
+/**
+ * @brief CRC-32 (IEEE 802.3, как zlib и утилита crc32)
+ *
+ * @param crc результат предыдущего вызова или 0 для нового подсчета
+ * @param data данные
+ * @param len длина в байтах
+ * @return u32 контрольная сумма
+ **/
+u32 crc32(u32 crc, const void* data, u32 len);
+
+/**
+ * @brief CRC-32C (Castagnoli): при SSE4.2 считается инструкцией crc32, иначе таблицами
+ *
+ * @param crc результат предыдущего вызова или 0 для нового подсчета
+ * @param data данные
+ * @param len длина в байтах
+ * @return u32 контрольная сумма
+ **/
+u32 crc32c(u32 crc, const void* data, u32 len);
+
+/**
+ * @brief Adler-32 (как zlib)
+ *
+ * @param adler результат предыдущего вызова или 1 для нового подсчета
+ * @param data данные
+ * @param len длина в байтах
+ * @return u32 контрольная сумма
+ **/
+u32 adler32(u32 adler, const void* data, u32 len);
+
+#endif
@@ -8,6 +8,8 @@
 #ifndef KKLIBC_CTYPES_H
 #define KKLIBC_CTYPES_H
 
+typedef unsigned long long u64;
+typedef long long s64;
 typedef unsigned int u32;
 typedef int s32;
 typedef unsigned short u16;
@@ -1,10 +1,14 @@
 #ifndef KKLIBC_H
 #define KKLIBC_H
 
+#include "arena.h"
+#include "checksum.h"
 #include "ctypes.h"
 #include "function.h"
+#include "magazine.h"
 #include "math.h"
 #include "mem.h"
+#include "slab.h"
 #include "stdio.h"
 #include "stdlib.h"
 
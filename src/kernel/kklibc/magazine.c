@@ -0,0 +1,168 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS KKLIBC source code
+ *  File: kklibc/magazine.c
+ *  Title: Выделение памяти в обработчиках прерываний
+ *	Description: Обработчик IRQ может прервать kmalloc/kfree посреди работы с
+ *	корзинами, поэтому сам он работает только с магазинами: снять или положить
+ *	указатель - несколько инструкций под irq_save. Куча используется только в
+ *	kmalloc_irq_refill, который вызывается вне обработчиков.
+ * ----------------------------------------------------------------------------*/
+
+#include "magazine.h"
+
+#include "../cpu/isr.h"
+#include "mem.h"
+#include "stdio.h"
+
+static kmem_magazine_t magazines[MAG_CLASSES];
+
+static void* deferred[MAG_DEFERRED];
+static u32 deferred_count = 0;
+static u32 deferred_lost = 0;    // kfree_irq при полной очереди отложенных (блок остается занятым)
+
+// магазин для запроса size: наименьший подходящий класс
+static kmem_magazine_t* mag_for_size(u32 size) {
+    for (u32 i = 0; i < MAG_CLASSES; i++) {
+        if (size <= magazines[i].object_size) {
+            return &magazines[i];
+        }
+    }
+    return NULL;
+}
+
+// магазин для возвращаемого блока: блок вмещает object_size, но не вдвое больше
+// (mem_split_block может оставить блоку лишние BLOCK_SIZE байт)
+static kmem_magazine_t* mag_for_block(void* ptr) {
+    u32 size = ((mem_block_t*)((u32)ptr - BLOCK_HEADER_SIZE))->size;
+
+    for (u32 i = MAG_CLASSES; i-- > 0;) {
+        if (size >= magazines[i].object_size) {
+            return size < magazines[i].object_size * 2 ? &magazines[i] : NULL;
+        }
+    }
+    return NULL;
+}
+
+void kmalloc_irq_init() {
+    for (u32 i = 0; i < MAG_CLASSES; i++) {
+        kmem_magazine_t* mag = &magazines[i];
+
+        mag->object_size = MAG_MIN_SIZE << i;
+        mag->count = 0;
+        mag->alloc_count = 0;
+        mag->free_count = 0;
+        mag->miss_count = 0;
+        mag->refill_count = 0;
+    }
+    deferred_count = 0;
+    deferred_lost = 0;
+
+    kmalloc_irq_refill();
+}
+
+void* kmalloc_irq(u32 size) {
+    kmem_magazine_t* mag = mag_for_size(size);
+    if (!mag || size == 0) {
+        printf("WARNING: kmalloc_irq called with size %d (max %d)\n", size, MAG_MAX_SIZE);
+        return NULL;
+    }
+
+    void* ptr = NULL;
+    u32 flags = irq_save();
+    if (mag->count) {
+        ptr = mag->objects[--mag->count];
+        mag->alloc_count++;
+    } else {
+        mag->miss_count++;
+    }
+    irq_restore(flags);
+
+    if (!ptr && !in_interrupt()) {
+        ptr = kmalloc(mag->object_size);
+    }
+    return ptr;
+}
+
+void kfree_irq(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    kmem_magazine_t* mag = mag_for_block(ptr);
+    u32 flags = irq_save();
+
+    if (mag && mag->count < MAG_CAPACITY) {
+        mag->objects[mag->count++] = ptr;
+        mag->free_count++;
+        irq_restore(flags);
+        return;
+    }
+
+    if (!in_interrupt()) {
+        irq_restore(flags);
+        kfree(ptr);
+        return;
+    }
+
+    if (deferred_count < MAG_DEFERRED) {
+        deferred[deferred_count++] = ptr;
+    } else {
+        deferred_lost++;
+    }
+    irq_restore(flags);
+}
+
+void kmalloc_irq_refill() {
+    void* pending[MAG_DEFERRED];
+
+    // забираем отложенные kfree, сами kfree - уже с разрешенными прерываниями
+    u32 flags = irq_save();
+    u32 count = deferred_count;
+    for (u32 i = 0; i < count; i++) {
+        pending[i] = deferred[i];
+    }
+    deferred_count = 0;
+    irq_restore(flags);
+
+    for (u32 i = 0; i < count; i++) {
+        kfree(pending[i]);
+    }
+
+    for (u32 i = 0; i < MAG_CLASSES; i++) {
+        kmem_magazine_t* mag = &magazines[i];
+
+        while (mag->count < MAG_CAPACITY) {
+            void* ptr = kmalloc(mag->object_size);
+            if (!ptr) {
+                return;
+            }
+
+            flags = irq_save();
+            if (mag->count < MAG_CAPACITY) {
+                mag->objects[mag->count++] = ptr;
+                mag->refill_count++;
+                ptr = NULL;
+            }
+            irq_restore(flags);
+
+            kfree(ptr);    // магазин успел пополниться через kfree_irq
+        }
+    }
+}
+
+void kmalloc_irq_dump() {
+    printf("IRQ magazines (deferred frees: %d, lost: %d):\n", deferred_count, deferred_lost);
+    for (u32 i = 0; i < MAG_CLASSES; i++) {
+        kmem_magazine_t* mag = &magazines[i];
+
+        printf(
+            "  %d bytes: %d/%d ready, allocs=%d frees=%d misses=%d refilled=%d\n",
+            mag->object_size,
+            mag->count,
+            MAG_CAPACITY,
+            mag->alloc_count,
+            mag->free_count,
+            mag->miss_count,
+            mag->refill_count);
+    }
+}
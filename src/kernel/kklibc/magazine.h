@@ -0,0 +1,73 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS C Libraries source code
+ *  File: libc/magazine.h
+ *  Title: Выделение памяти в обработчиках прерываний (заголовочный файл magazine.c)
+ *	Description: Магазины заранее выделенных блоков нескольких размеров. Обработчик
+ *	IRQ берет и возвращает блоки за O(1), не трогая корзины кучи; пополнение
+ *	магазинов и возврат лишних блоков в кучу - вне обработчиков.
+ * ----------------------------------------------------------------------------*/
+
+#ifndef KKLIBC_MAGAZINE_H
+#define KKLIBC_MAGAZINE_H
+
+#include "ctypes.h"
+
+#define MAG_CLASSES 4    // размеры блоков: 32, 64, 128, 256 байт
+#define MAG_MIN_SIZE 32
+#define MAG_MAX_SIZE (MAG_MIN_SIZE << (MAG_CLASSES - 1))
+#define MAG_CAPACITY 16    // блоков в одном магазине
+#define MAG_DEFERRED 32    // отложенные kfree из обработчиков при полном магазине
+
+/**
+ * @brief Магазин блоков одного размера
+ *
+ **/
+typedef struct kmem_magazine {
+    u32 object_size;
+    u32 count;    // сколько блоков сейчас в магазине
+    void* objects[MAG_CAPACITY];
+    u32 alloc_count;
+    u32 free_count;
+    u32 miss_count;    // kmalloc_irq при пустом магазине
+    u32 refill_count;    // блоков добавлено из кучи
+} kmem_magazine_t;
+
+/**
+ * @brief Начальное заполнение магазинов (после heap_init)
+ **/
+void kmalloc_irq_init();
+
+/**
+ * @brief Выделение блока, безопасное в обработчике IRQ
+ *
+ * Внутри обработчика блок берется только из магазина (NULL, если он пуст),
+ * вне обработчика при пустом магазине используется kmalloc.
+ *
+ * @param size размер (не больше MAG_MAX_SIZE)
+ * @return void* блок или NULL
+ **/
+void* kmalloc_irq(u32 size);
+
+/**
+ * @brief Освобождение блока, безопасное в обработчике IRQ
+ *
+ * Блок возвращается в магазин своего размера; если магазин полон, внутри
+ * обработчика kfree откладывается до kmalloc_irq_refill.
+ *
+ * @param ptr блок из kmalloc_irq (или kmalloc размером до MAG_MAX_SIZE)
+ **/
+void kfree_irq(void* ptr);
+
+/**
+ * @brief Пополнение магазинов из кучи и выполнение отложенных kfree
+ *
+ * Вызывается вне обработчиков прерываний, которые могут прервать kmalloc/kfree.
+ **/
+void kmalloc_irq_refill();
+
+/**
+ * @brief Вывод состояния магазинов
+ **/
+void kmalloc_irq_dump();
+
+#endif
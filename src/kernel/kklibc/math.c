@@ -17,3 +17,89 @@ int binary_pow(int b, u32 e) {
     }
     return v;
 }
+
+u64 div64_u32(u64 n, u32 d, u32* rem) {
+    u32 high = (u32)(n >> 32);
+    u32 low = (u32)n;
+    u32 q_high = 0;
+    u32 r = 0;
+
+    // старшая половина делится отдельно, чтобы частное второго divl поместилось в 32 бита
+    if (high >= d) {
+        q_high = high / d;
+        high %= d;
+    }
+
+    u32 q_low;
+    __asm__("divl %4" : "=a"(q_low), "=d"(r) : "a"(low), "d"(high), "rm"(d));
+
+    if (rem) {
+        *rem = r;
+    }
+    return ((u64)q_high << 32) | q_low;
+}
+
+static u32 bsr32(u32 x) {
+    u32 index;
+    __asm__("bsr %1, %0" : "=r"(index) : "rm"(x));
+    return index;
+}
+
+u64 udivmod64(u64 n, u64 d, u64* rem) {
+    u32 d_high = (u32)(d >> 32);
+
+    if (d_high == 0) {
+        u32 r;
+        u64 q = div64_u32(n, (u32)d, &r);
+        if (rem) {
+            *rem = r;
+        }
+        return q;
+    }
+
+    // делитель не меньше 2^32 - частное меньше 2^32, делим сдвигом и вычитанием
+    u64 q = 0;
+    if (n >= d) {
+        u32 shift = bsr32((u32)(n >> 32)) - bsr32(d_high);
+        d <<= shift;
+
+        for (u32 i = 0; i <= shift; i++) {
+            q <<= 1;
+            if (n >= d) {
+                n -= d;
+                q |= 1;
+            }
+            d >>= 1;
+        }
+    }
+
+    if (rem) {
+        *rem = n;
+    }
+    return q;
+}
+
+u64 __udivdi3(u64 n, u64 d) {
+    return udivmod64(n, d, NULL);
+}
+
+u64 __umoddi3(u64 n, u64 d) {
+    u64 rem;
+    udivmod64(n, d, &rem);
+    return rem;
+}
+
+u64 __udivmoddi4(u64 n, u64 d, u64* rem) {
+    return udivmod64(n, d, rem);
+}
+
+s64 __divdi3(s64 n, s64 d) {
+    u64 q = udivmod64(n < 0 ? -(u64)n : (u64)n, d < 0 ? -(u64)d : (u64)d, NULL);
+    return ((n < 0) != (d < 0)) ? -(s64)q : (s64)q;
+}
+
+s64 __moddi3(s64 n, s64 d) {
+    u64 rem;
+    udivmod64(n < 0 ? -(u64)n : (u64)n, d < 0 ? -(u64)d : (u64)d, &rem);
+    return n < 0 ? -(s64)rem : (s64)rem;
+}
@@ -18,4 +18,32 @@
  **/
 int binary_pow(int b, u32 e);
 
+/**
+ * @brief Деление 64-битного числа на 32-битное (две инструкции divl)
+ *
+ * @param n делимое
+ * @param d делитель (0 - исключение #DE, как у divl)
+ * @param rem остаток (может быть NULL)
+ * @return u64 частное
+ **/
+u64 div64_u32(u64 n, u32 d, u32* rem);
+
+/**
+ * @brief Деление 64-битных чисел без знака
+ *
+ * @param n делимое
+ * @param d делитель
+ * @param rem остаток (может быть NULL)
+ * @return u64 частное
+ **/
+u64 udivmod64(u64 n, u64 d, u64* rem);
+
+/* Ядро собирается без libgcc, поэтому операторы / и % над u64/s64 вызывают
+ * эти функции из math.c (имена и соглашение - как в libgcc) */
+u64 __udivdi3(u64 n, u64 d);
+u64 __umoddi3(u64 n, u64 d);
+u64 __udivmoddi4(u64 n, u64 d, u64* rem);
+s64 __divdi3(s64 n, s64 d);
+s64 __moddi3(s64 n, s64 d);
+
 #endif
@@ -10,49 +10,298 @@
 #include "../drivers/screen.h"
 #include "../kernel/sysinfo.h"
 #include "ctypes.h"
+#include "memprof.h"
+#include "pmm.h"
 #include "stdio.h"
 #include "stdlib.h"
 
 u32 free_mem_addr = HEAP_START;
-static mem_block_t* free_blocks = NULL;
-u32 heap_current_end = HEAP_START + HEAP_SIZE;
+u32 heap_current_end = HEAP_START;
+
+/* Корзины свободных блоков и битовая карта непустых корзин */
+static mem_block_t* bins[MEM_BIN_COUNT];
+static u32 bin_map = 0;
+
+/* Последний физический блок кучи (к нему пристыковывается expand_heap) */
+static mem_block_t* heap_last_block = NULL;
+static u8 heap_selfcheck = 0;
 
 static meminfo_t stats;
 
+/* Shrinker'ы кэшей, к которым куча обращается перед тем, как вернуть NULL */
+static struct {
+    const char* name;
+    mem_shrinker_t shrink;
+    u32 calls;
+    u32 reclaimed;
+} shrinkers[MEM_SHRINKERS];
+static u32 shrinker_count = 0;
+
+#define BLOCK_NEXT_PHYS(block) ((mem_block_t*)((u32)(block) + BLOCK_HEADER_SIZE + (block)->size))
+
+// индекс старшего установленного бита (x != 0)
+static inline u32 mem_log2(u32 x) {
+    u32 r;
+    __asm__("bsr %1, %0" : "=r"(r) : "rm"(x));
+    return r;
+}
+
+// индекс младшего установленного бита (x != 0)
+static inline u32 mem_lowest_bit(u32 x) {
+    u32 r;
+    __asm__("bsf %1, %0" : "=r"(r) : "rm"(x));
+    return r;
+}
+
+// корзина, в которой должен храниться свободный блок данного размера
+static u32 mem_bin_index(u32 size) {
+    if (size >= (BLOCK_SIZE << MEM_SMALL_BINS)) {
+        return MEM_LARGE_BIN;
+    }
+    if (size < BLOCK_SIZE) {
+        return 0;
+    }
+
+    return mem_log2(size) - mem_log2(BLOCK_SIZE);
+}
+
+static void mem_bin_insert(mem_block_t* block) {
+    u32 index = mem_bin_index(block->size);
+
+    block->is_free = 1;
+    block->prev = NULL;
+    block->next = bins[index];
+    if (bins[index]) {
+        bins[index]->prev = block;
+    }
+    bins[index] = block;
+    bin_map |= 1 << index;
+
+    stats.bin_blocks[index]++;
+    stats.bin_bytes[index] += block->size;
+    stats.total_free += block->size;
+}
+
+static void mem_bin_remove(mem_block_t* block) {
+    u32 index = mem_bin_index(block->size);
+
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        bins[index] = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    }
+    if (!bins[index]) {
+        bin_map &= ~(1 << index);
+    }
+
+    block->next = NULL;
+    block->prev = NULL;
+
+    stats.bin_blocks[index]--;
+    stats.bin_bytes[index] -= block->size;
+    stats.total_free -= block->size;
+}
+
+// O(1): первая непустая корзина, любой блок которой гарантированно вмещает size
+static mem_block_t* mem_find_small(u32 size) {
+    u32 index = mem_log2(size) - mem_log2(BLOCK_SIZE);
+    if (size & (size - 1)) {
+        index++;    // не степень двойки - в корзине index могут быть блоки меньше size
+    }
+
+    u32 mask = bin_map & ~((1 << index) - 1);
+    if (!mask) {
+        return NULL;
+    }
+
+    return bins[mem_lowest_bit(mask)];
+}
+
+// best-fit для крупных запросов: корзины упорядочены по размеру,
+// поэтому первая корзина с подходящим блоком содержит лучший вариант
+static mem_block_t* mem_find_best_fit(u32 size) {
+    for (u32 index = mem_bin_index(size); index < MEM_BIN_COUNT; index++) {
+        mem_block_t* best_fit = NULL;
+
+        for (mem_block_t* current = bins[index]; current; current = current->next) {
+            if (current->size >= size && (!best_fit || current->size < best_fit->size)) {
+                best_fit = current;
+            }
+        }
+
+        if (best_fit) {
+            return best_fit;
+        }
+    }
+
+    return NULL;
+}
+
+// физически следующий блок или NULL, если block последний в куче
+static mem_block_t* mem_next_phys(mem_block_t* block) {
+    mem_block_t* next = BLOCK_NEXT_PHYS(block);
+    if ((u32)next >= heap_current_end) {
+        return NULL;
+    }
+    return next;
+}
+
+// присоединение физически следующего блока next (уже вынутого из корзины) к block
+static void mem_absorb_next(mem_block_t* block, mem_block_t* next) {
+    block->size += BLOCK_HEADER_SIZE + next->size;
+    stats.block_count--;
+
+    mem_block_t* after = mem_next_phys(block);
+    if (after) {
+        after->prev_phys = block;
+    } else {
+        heap_last_block = block;
+    }
+}
+
+// отрезаем от блока хвост, если он достаточно велик для отдельного блока
+static void mem_split_block(mem_block_t* block, u32 size) {
+    if (block->size < size + BLOCK_HEADER_SIZE + BLOCK_SIZE) {
+        return;
+    }
+
+    mem_block_t* new_block = (mem_block_t*)((u32)block + BLOCK_HEADER_SIZE + size);
+    new_block->size = block->size - size - BLOCK_HEADER_SIZE;
+    new_block->prev_phys = block;
+    new_block->magic = MAGIC_NUMBER;
+    block->size = size;
+    stats.block_count++;
+
+    mem_block_t* next = mem_next_phys(new_block);
+    if (!next) {
+        heap_last_block = new_block;
+    } else {
+        next->prev_phys = new_block;
+
+        // хвост мог оказаться рядом со свободным блоком (уменьшение в krealloc)
+        if (next->is_free) {
+            mem_bin_remove(next);
+            mem_absorb_next(new_block, next);
+        }
+    }
+
+    mem_bin_insert(new_block);
+}
+
 // инициализация кучи
 void heap_init() {
-    free_blocks = (mem_block_t*)HEAP_START;
-    free_blocks->size = HEAP_SIZE - sizeof(mem_block_t);
-    free_blocks->next = NULL;
-    free_blocks->is_free = 1;
-    heap_current_end = HEAP_START + HEAP_SIZE;
+    for (u32 i = 0; i < MEM_BIN_COUNT; i++) {
+        bins[i] = NULL;
+        stats.bin_blocks[i] = 0;
+        stats.bin_bytes[i] = 0;
+    }
+    bin_map = 0;
+
+    heap_current_end = HEAP_START;
+    heap_last_block = NULL;
 
     stats.alloc_count = 0;
     stats.free_count = 0;
     stats.max_used = 0;
     stats.leak_count = 0;
+    stats.total_used = 0;
+    stats.total_free = 0;
+    stats.block_count = 0;
+    stats.realloc_inplace = 0;
+    stats.realloc_copied = 0;
+    stats.realloc_copied_bytes = 0;
+    stats.shrink_runs = 0;
+    stats.shrink_reclaimed = 0;
+    stats.oom_count = 0;
+    memprof_reset(1);
+
+    // пустая куча растет так же, как и любая другая - фреймами из pmm
+    if (!expand_heap(HEAP_INITIAL_SIZE)) {
+        printf("ERROR: No physical memory for heap at 0x%x\n", HEAP_START);
+    }
 
-    // printf("Heap initialized at 0x%x with size: %d bytes\n", HEAP_START, HEAP_SIZE);
+    // printf("Heap initialized at 0x%x with size: %d bytes\n", HEAP_START, HEAP_INITIAL_SIZE);
 }
 
 int expand_heap(u32 size) {
-    if (heap_current_end + size > HEAP_START + HEAP_SIZE) {
-        return 0;
-    }
+    u32 needed = (size + PMM_FRAME_SIZE - 1) & ~(PMM_FRAME_SIZE - 1);
+    u32 grow = needed < HEAP_GROW_MIN ? HEAP_GROW_MIN : needed;
 
-    u32 expand_size = size;
+    // куча непрерывна, поэтому растет только за счет фреймов сразу за своим концом
+    if (!pmm_claim_range(heap_current_end, grow)) {
+        if (grow == needed || !pmm_claim_range(heap_current_end, needed)) {
+            return 0;
+        }
+        grow = needed;
+    }
 
     mem_block_t* new_block = (mem_block_t*)heap_current_end;
-    new_block->size = expand_size - sizeof(mem_block_t);
-    new_block->is_free = 1;
-    new_block->next = free_blocks;
-    free_blocks = new_block;
+    new_block->size = grow - BLOCK_HEADER_SIZE;
+    new_block->prev_phys = heap_last_block;
+    new_block->magic = MAGIC_NUMBER;
+    new_block->is_free = 0;
+    heap_current_end += grow;
+    heap_last_block = new_block;
+    stats.block_count++;
+
+    // новый участок продолжает последний блок кучи - сливаем, если тот свободен
+    mem_block_t* prev = new_block->prev_phys;
+    if (prev && prev->is_free) {
+        mem_bin_remove(prev);
+        mem_absorb_next(prev, new_block);
+        new_block = prev;
+    }
 
-    heap_current_end += expand_size;
+    mem_bin_insert(new_block);
     return 1;
 }
 
-void* kmalloc(u32 size) {
+// поиск свободного блока не меньше size (кратно BLOCK_SIZE); блок вынимается из корзины
+static mem_block_t* mem_take_block(u32 size) {
+    mem_block_t* block;
+    if (size <= MEM_SMALL_MAX) {
+        block = mem_find_small(size);
+    } else {
+        block = mem_find_best_fit(size);
+    }
+
+    if (!block) {
+        // сначала растим кучу, затем просим кэши вернуть память; пока хоть что-то
+        // освобождается, пробуем снова (освобожденное могло оказаться не рядом)
+        if (!expand_heap(size + BLOCK_HEADER_SIZE) && !mem_shrink(size + BLOCK_HEADER_SIZE)) {
+            return NULL;
+        }
+        return mem_take_block(size);
+    }
+
+    mem_bin_remove(block);
+    block->is_free = 0;
+    return block;
+}
+
+// блок выдан пользователю: отрезаем лишний хвост и обновляем статистику
+static void* mem_commit_block(mem_block_t* block, u32 size, u32 caller) {
+    mem_split_block(block, size);
+    block->site = memprof_alloc(caller, block->size, mem_bin_index(block->size));
+
+    stats.alloc_count++;
+    stats.total_used += block->size;
+    if (stats.total_used > stats.max_used) {
+        stats.max_used = stats.total_used;
+    }
+
+    return (void*)((u32)block + BLOCK_HEADER_SIZE);
+}
+
+static void mem_out_of_memory(u32 size, u32 aligned_size) {
+    stats.oom_count++;
+    printf("ERROR: Out of memory! Requested: %d (aligned: %d)\n", size, aligned_size);
+}
+
+static void* mem_alloc(u32 size, u32 caller) {
     if (size == 0) {
         printf("WARNING: kmalloc called with size 0\n");
         return NULL;
@@ -60,99 +309,134 @@ void* kmalloc(u32 size) {
 
     u32 aligned_size = (size + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
 
-    mem_block_t* current = free_blocks;
-    mem_block_t* prev = NULL;
-    mem_block_t* best_fit = NULL;
-    mem_block_t* best_fit_prev = NULL;
-
-    while (current) {
-        if (current->is_free && current->size >= aligned_size) {
-            if (!best_fit || current->size < best_fit->size) {
-                best_fit = current;
-                best_fit_prev = prev;
-            }
-        }
-        prev = current;
-        current = current->next;
+    mem_block_t* block = mem_take_block(aligned_size);
+    if (block) {
+        return mem_commit_block(block, aligned_size, caller);
     }
 
-    if (best_fit) {
-        if (best_fit_prev) {
-            best_fit_prev->next = best_fit->next;
-        } else {
-            free_blocks = best_fit->next;
-        }
-
-        if (best_fit->size > aligned_size + sizeof(mem_block_t) + BLOCK_SIZE) {
-            mem_block_t* new_block = (mem_block_t*)((u32)best_fit + sizeof(mem_block_t) + aligned_size);
-            new_block->size = best_fit->size - aligned_size - sizeof(mem_block_t);
-            new_block->is_free = 1;
-            new_block->next = best_fit->next;
+    mem_out_of_memory(size, aligned_size);
+    return NULL;
+}
 
-            best_fit->size = aligned_size;
-            best_fit->next = new_block;
+void* kmalloc(u32 size) {
+    return mem_alloc(size, (u32)__builtin_return_address(0));
+}
 
-            if (best_fit_prev) {
-                best_fit_prev->next = new_block;
-            } else {
-                free_blocks = new_block;
-            }
-        }
+void* kmalloc_aligned(u32 size, u32 alignment) {
+    if (size == 0 || (alignment & (alignment - 1))) {
+        printf("WARNING: kmalloc_aligned called with size %d, alignment %d\n", size, alignment);
+        return NULL;
+    }
 
-        best_fit->is_free = 0;
+    u32 caller = (u32)__builtin_return_address(0);
 
-        void* user_ptr = (void*)((u32)best_fit + sizeof(mem_block_t));
+    // данные любого блока уже выровнены на BLOCK_SIZE
+    if (alignment <= BLOCK_SIZE) {
+        return mem_alloc(size, caller);
+    }
 
-        stats.alloc_count++;
-        stats.total_used += best_fit->size;
-        if (stats.total_used > stats.max_used) {
-            stats.max_used = stats.total_used;
-        }
+    u32 aligned_size = (size + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
 
-        return user_ptr;
+    // запас на отрезаемый спереди свободный блок (заголовок + минимум BLOCK_SIZE данных)
+    mem_block_t* block = mem_take_block(aligned_size + alignment + BLOCK_HEADER_SIZE + BLOCK_SIZE);
+    if (!block) {
+        mem_out_of_memory(size, aligned_size);
+        return NULL;
     }
 
-    if (expand_heap(aligned_size + sizeof(mem_block_t))) {
-        return kmalloc(size);
+    u32 data = (u32)block + BLOCK_HEADER_SIZE;
+    u32 target = (data + alignment - 1) & ~(alignment - 1);
+    if (target != data && target - data < BLOCK_HEADER_SIZE + BLOCK_SIZE) {
+        target += alignment;
     }
 
-    printf("ERROR: Out of memory! Requested: %d (aligned: %d)\n", size, aligned_size);
-    kmemdump();
+    if (target != data) {
+        // начало блока до target становится отдельным свободным блоком
+        mem_block_t* aligned = (mem_block_t*)(target - BLOCK_HEADER_SIZE);
+        u32 lead_size = (u32)aligned - (u32)block;
+
+        aligned->size = block->size - lead_size;
+        aligned->prev_phys = block;
+        aligned->magic = MAGIC_NUMBER;
+        aligned->is_free = 0;
+        block->size = lead_size - BLOCK_HEADER_SIZE;
+        stats.block_count++;
+
+        mem_block_t* next = mem_next_phys(aligned);
+        if (next) {
+            next->prev_phys = aligned;
+        } else {
+            heap_last_block = aligned;
+        }
+
+        // соседи блока из корзины заняты, поэтому сливать передний кусок не с чем
+        mem_bin_insert(block);
+        block = aligned;
+    }
 
-    __asm__ volatile("hlt");
+    return mem_commit_block(block, aligned_size, caller);
+}
 
-    return NULL;
+void kfree_aligned(void* ptr) {
+    // выровненный блок - обычный блок кучи, передний кусок уже вернулся в корзину
+    kfree(ptr);
 }
 
 void* krealloc(void* ptr, u32 size) {
+    u32 caller = (u32)__builtin_return_address(0);
+
     if (!ptr) {
-        return kmalloc(size);
+        return mem_alloc(size, caller);
     }
     if (size == 0) {
         kfree(ptr);
         return NULL;
     }
 
-    mem_block_t* block = (mem_block_t*)((u32)ptr - sizeof(mem_block_t));
-    if (block->size >= size) {
-        // уменьшение блока при необходимости
-        if (block->size - size >= sizeof(mem_block_t) + BLOCK_SIZE) {
-            mem_block_t* new_block = (mem_block_t*)((u32)block + sizeof(mem_block_t) + size);
-            new_block->size = block->size - size - sizeof(mem_block_t);
-            new_block->is_free = 1;
-            new_block->next = block->next;
-            block->next = new_block;
+    memprof_realloc(caller);
+
+    mem_block_t* block = (mem_block_t*)((u32)ptr - BLOCK_HEADER_SIZE);
+    u32 aligned_size = (size + BLOCK_SIZE - 1) & ~(BLOCK_SIZE - 1);
+    u32 old_size = block->size;
+
+    if (old_size < aligned_size) {
+        mem_block_t* next = mem_next_phys(block);
+
+        // последний блок кучи: дорастим кучу, новый участок встанет сразу за ним
+        if (!next && expand_heap(aligned_size - old_size)) {
+            next = mem_next_phys(block);
         }
-        return ptr;
+
+        if (!next || !next->is_free || old_size + BLOCK_HEADER_SIZE + next->size < aligned_size) {
+            // на месте не помещается - выделяем новый блок и копируем данные
+            void* new_ptr = mem_alloc(size, caller);
+            if (new_ptr) {
+                memcpy(new_ptr, ptr, old_size);
+                kfree(ptr);
+                stats.realloc_copied++;
+                stats.realloc_copied_bytes += old_size;
+            }
+            return new_ptr;
+        }
+
+        // рост на месте: забираем свободный блок справа целиком, лишнее отрежет mem_split_block
+        mem_bin_remove(next);
+        mem_absorb_next(block, next);
     }
 
-    // выделяем нового блока и копипастим данных
-    void* new_ptr = kmalloc(size);
-    if (new_ptr) {
-        memcpy(new_ptr, ptr, block->size);
-        kfree(ptr);
+    // уменьшение (или остаток после роста) - хвост уходит в свою корзину
+    mem_split_block(block, aligned_size);
+    stats.realloc_inplace++;
+    if (block->size >= old_size) {
+        stats.total_used += block->size - old_size;
+    } else {
+        stats.total_used -= old_size - block->size;
+    }
+    if (stats.total_used > stats.max_used) {
+        stats.max_used = stats.total_used;
     }
-    return new_ptr;
+    memprof_resize(block->site, old_size, block->size);
+    return ptr;
 }
 
 void kfree(void* ptr) {
@@ -160,10 +444,11 @@ void kfree(void* ptr) {
         return;
     }
 
-    mem_block_t* block = (mem_block_t*)((u32)ptr - sizeof(mem_block_t));
+    mem_block_t* block = (mem_block_t*)((u32)ptr - BLOCK_HEADER_SIZE);
 
     // Проверяем базовую валидность
-    if ((u32)block < HEAP_START || (u32)block >= heap_current_end) {
+    if ((u32)block < HEAP_START || (u32)block >= heap_current_end || ((u32)ptr & (BLOCK_SIZE - 1))
+        || block->magic != MAGIC_NUMBER) {
         printf("ERROR: Invalid free pointer: 0x%x\n", (u32)ptr);
         return;
     }
@@ -177,68 +462,76 @@ void kfree(void* ptr) {
     block->is_free = 1;
     stats.free_count++;
     stats.total_used -= block->size;
+    memprof_free(block->site, block->size);
 
     // printf("[kfree] Freed %d bytes at 0x%x (block: 0x%x)\n",
     //        block->size, (u32)ptr, (u32)block);
 
-    // Сливаем с соседними свободными блоками
-    // Слияние с следующим блоком
-    if (block->next && block->next->is_free) {
-        block->size += sizeof(mem_block_t) + block->next->size;
-        block->next = block->next->next;
+    // Сливаем с соседними свободными блоками за O(1) по boundary tags
+    // Слияние со следующим физическим блоком
+    mem_block_t* next = mem_next_phys(block);
+    if (next && next->is_free) {
+        mem_bin_remove(next);
+        mem_absorb_next(block, next);
         // printf("[kfree] Merged with next block\n");
     }
 
-    // Слияние с предыдущим блоком (нужно найти в списке)
-    mem_block_t* current = free_blocks;
-    mem_block_t* prev = NULL;
+    // Слияние с предыдущим физическим блоком
+    mem_block_t* prev = block->prev_phys;
+    if (prev && prev->is_free) {
+        mem_bin_remove(prev);
+        mem_absorb_next(prev, block);
+        block = prev;
+        // printf("[kfree] Merged with previous block\n");
+    }
 
-    while (current) {
-        if (current->is_free && (u32)current + sizeof(mem_block_t) + current->size == (u32)block) {
-            // Текущий блок свободен и примыкает к нашему блоку
-            current->size += sizeof(mem_block_t) + block->size;
-            current->next = block->next;
-            // printf("[kfree] Merged with previous block\n");
-            return;
-        }
-        prev = current;
-        current = current->next;
+    mem_bin_insert(block);
+
+    if (heap_selfcheck && kmemverify() != 0) {
+        printf("ERROR: Heap inconsistent after kfree(0x%x)\n", (u32)ptr);
     }
 }
 
-meminfo_t get_meminfo() {
-    u32 current_addr = HEAP_START;
-    mem_block_t* current = free_blocks;
-    u32 heap_end = heap_current_end;
-    u32 total_used = 0;
-    u32 total_free = 0;
-    u32 block_count = 0;
-    u32 used_blocks = 0;
-
-    while (current_addr < heap_end) {
-        mem_block_t* block = (mem_block_t*)current_addr;
-        block_count++;
+// O(1): total_used, total_free и block_count ведутся в kmalloc/kfree/krealloc,
+// сверка с полным обходом кучи - в kmemverify
+int mem_register_shrinker(const char* name, mem_shrinker_t shrink) {
+    if (shrinker_count >= MEM_SHRINKERS) {
+        printf("WARNING: No room for shrinker %s\n", name);
+        return 0;
+    }
 
-        if (block->is_free) {
-            total_free += block->size;
-        } else {
-            total_used += block->size;
-            used_blocks++;
-        }
+    shrinkers[shrinker_count].name = name;
+    shrinkers[shrinker_count].shrink = shrink;
+    shrinkers[shrinker_count].calls = 0;
+    shrinkers[shrinker_count].reclaimed = 0;
+    shrinker_count++;
+
+    return 1;
+}
+
+u32 mem_shrink(u32 wanted) {
+    u32 reclaimed = 0;
 
-        current_addr += sizeof(mem_block_t) + block->size;
+    stats.shrink_runs++;
+    for (u32 i = 0; i < shrinker_count && reclaimed < wanted; i++) {
+        u32 freed = shrinkers[i].shrink(wanted - reclaimed);
+
+        shrinkers[i].calls++;
+        shrinkers[i].reclaimed += freed;
+        reclaimed += freed;
     }
 
-    stats.total_used = total_used;
-    stats.total_free = total_free;
-    stats.block_count = block_count;
-    stats.leak_count = used_blocks;
+    stats.shrink_reclaimed += reclaimed;
+    return reclaimed;
+}
+
+meminfo_t get_meminfo() {
+    stats.leak_count = stats.alloc_count - stats.free_count;    // каждый занятый блок выдан одним kmalloc
 
     stats.heap_start = HEAP_START;
     stats.heap_size = heap_current_end - HEAP_START;
     stats.heap_current_end = heap_current_end;
     stats.block_size = BLOCK_SIZE;
-    stats.free_blocks = free_blocks;
 
     return stats;
 }
@@ -259,6 +552,28 @@ void kmemdump() {
     printf(
         "Max used: %d bytes, Current: USED=%d, FREE=%d\n", info.max_used, info.total_used, info.total_free);
     printf("Total blocks: %d\n", info.block_count);
+    printf(
+        "Reallocs: %d in place, %d copied (%d bytes)\n",
+        info.realloc_inplace,
+        info.realloc_copied,
+        info.realloc_copied_bytes);
+    printf(
+        "Shrinkers: %d runs, %d bytes reclaimed, %d failed allocations\n",
+        info.shrink_runs,
+        info.shrink_reclaimed,
+        info.oom_count);
+    for (u32 i = 0; i < shrinker_count; i++) {
+        printf("  %s: %d calls, %d bytes\n", shrinkers[i].name, shrinkers[i].calls, shrinkers[i].reclaimed);
+    }
+
+    for (u32 i = 0; i < MEM_BIN_COUNT; i++) {
+        if (i == MEM_LARGE_BIN) {
+            printf("Bin %d [%d+]: ", i, BLOCK_SIZE << i);
+        } else {
+            printf("Bin %d [%d-%d]: ", i, BLOCK_SIZE << i, (BLOCK_SIZE << (i + 1)) - 1);
+        }
+        printf("%d free blocks, %d bytes\n", info.bin_blocks[i], info.bin_bytes[i]);
+    }
 
     while (current_addr < info.heap_current_end) {
         mem_block_t* block = (mem_block_t*)current_addr;
@@ -267,12 +582,121 @@ void kmemdump() {
             "Block %d: header=0x%x (pointer 0x%x), Size=%d, %s\n",
             counter++,
             (u32)block,
-            (u32)block + sizeof(mem_block_t),
+            (u32)block + BLOCK_HEADER_SIZE,
             block->size,
             block->is_free ? "FREE" : "USED");
 
-        current_addr += sizeof(mem_block_t) + block->size;
+        current_addr += BLOCK_HEADER_SIZE + block->size;
+    }
+}
+
+void heap_set_selfcheck(u8 enabled) {
+    heap_selfcheck = enabled;
+}
+
+int kmemverify() {
+    int errors = 0;
+    u32 chain_free = 0;
+    u32 chain_blocks = 0;
+    u32 chain_used_bytes = 0;
+    u32 chain_free_bytes = 0;
+    mem_block_t* prev = NULL;
+    u32 current_addr = HEAP_START;
+
+    // 1. Физическая цепочка: размеры, boundary tags, отсутствие соседних свободных блоков
+    while (current_addr < heap_current_end) {
+        mem_block_t* block = (mem_block_t*)current_addr;
+
+        if (block->magic != MAGIC_NUMBER) {
+            printf("heap: block 0x%x has bad magic 0x%x\n", current_addr, block->magic);
+            errors++;
+            break;    // размер такого блока тоже нельзя считать достоверным
+        }
+        if (block->prev_phys != prev) {
+            printf(
+                "heap: block 0x%x has prev_phys 0x%x, expected 0x%x\n",
+                current_addr,
+                (u32)block->prev_phys,
+                (u32)prev);
+            errors++;
+        }
+        if (block->is_free) {
+            chain_free++;
+            chain_free_bytes += block->size;
+            if (prev && prev->is_free) {
+                printf("heap: free blocks 0x%x and 0x%x are not merged\n", (u32)prev, current_addr);
+                errors++;
+            }
+        } else {
+            chain_used_bytes += block->size;
+        }
+
+        chain_blocks++;
+        prev = block;
+        current_addr += BLOCK_HEADER_SIZE + block->size;
+    }
+
+    if (current_addr != heap_current_end) {
+        printf("heap: block chain ends at 0x%x, heap ends at 0x%x\n", current_addr, heap_current_end);
+        errors++;
+    }
+    if (prev != heap_last_block) {
+        printf("heap: last block is 0x%x, expected 0x%x\n", (u32)heap_last_block, (u32)prev);
+        errors++;
     }
+
+    // 2. Корзины: только свободные блоки из кучи, каждый в своей корзине, корректные связи
+    u32 bins_free = 0;
+    for (u32 index = 0; index < MEM_BIN_COUNT; index++) {
+        u32 count = 0;
+        mem_block_t* expected_prev = NULL;
+
+        for (mem_block_t* current = bins[index]; current; current = current->next) {
+            if ((u32)current < HEAP_START || (u32)current >= heap_current_end) {
+                printf("heap: bin %d points outside heap: 0x%x\n", index, (u32)current);
+                errors++;
+                break;
+            }
+            if (!current->is_free || mem_bin_index(current->size) != index || current->prev != expected_prev) {
+                printf("heap: bad block 0x%x in bin %d\n", (u32)current, index);
+                errors++;
+            }
+
+            expected_prev = current;
+            if (++count > chain_blocks) {
+                printf("heap: bin %d is cyclic\n", index);
+                errors++;
+                break;
+            }
+        }
+
+        if (count != stats.bin_blocks[index] || ((bin_map >> index) & 1) != (count != 0)) {
+            printf("heap: bin %d counters out of sync\n", index);
+            errors++;
+        }
+        bins_free += count;
+    }
+
+    if (bins_free != chain_free) {
+        printf("heap: %d free blocks in chain, %d in bins\n", chain_free, bins_free);
+        errors++;
+    }
+
+    // 3. Счетчики, которые get_meminfo отдает без обхода
+    if (stats.block_count != chain_blocks || stats.total_used != chain_used_bytes
+        || stats.total_free != chain_free_bytes || stats.alloc_count - stats.free_count != chain_blocks - chain_free) {
+        printf(
+            "heap: counters blocks=%d used=%d free=%d, walk blocks=%d used=%d free=%d\n",
+            stats.block_count,
+            stats.total_used,
+            stats.total_free,
+            chain_blocks,
+            chain_used_bytes,
+            chain_free_bytes);
+        errors++;
+    }
+
+    return errors;
 }
 
 void kmemcheck(void* ptr) {
@@ -281,7 +705,7 @@ void kmemcheck(void* ptr) {
         return;
     }
 
-    mem_block_t* block = (mem_block_t*)((u32)ptr - sizeof(mem_block_t));
+    mem_block_t* block = (mem_block_t*)((u32)ptr - BLOCK_HEADER_SIZE);
 
     printf("kmemcheck for 0x%x:\n", (u32)ptr);
     printf("  Block at: 0x%x\n", (u32)block);
@@ -10,22 +10,45 @@
 
 #include "ctypes.h"
 
-#define HEAP_START 0x200000
-#define HEAP_SIZE 0x2000000
+#define HEAP_START 0x200000    // = PMM_RESERVED_END: куча начинается с первого фрейма аллокатора
+#define HEAP_INITIAL_SIZE 0x100000    // сколько фреймов куча берет при инициализации
+#define HEAP_GROW_MIN 0x10000    // минимальный шаг роста кучи
 #define BLOCK_SIZE 16
 #define MAGIC_NUMBER 0xDEADBEEF
 
+/* Сегрегированные списки свободных блоков (size-class bins).
+ * Корзина i (0..MEM_SMALL_BINS-1) хранит блоки размером [BLOCK_SIZE << i, BLOCK_SIZE << (i + 1)),
+ * последняя корзина - все блоки крупнее. Запросы до MEM_SMALL_MAX обслуживаются за O(1),
+ * более крупные - через best-fit по корзинам. */
+#define MEM_SMALL_BINS 8
+#define MEM_BIN_COUNT (MEM_SMALL_BINS + 1)
+#define MEM_LARGE_BIN MEM_SMALL_BINS
+#define MEM_SMALL_MAX (BLOCK_SIZE << (MEM_SMALL_BINS - 1))
+
+#define MEM_SHRINKERS 8    // сколько кэшей может зарегистрировать функцию освобождения памяти
+
 extern u32 heap_current_end;
 
 /**
  * @brief Блок памяти
  *
+ * Заголовок блока занимает ровно BLOCK_SIZE (16) байт, поэтому данные каждого блока
+ * выровнены на 16 байт. Ссылки next/prev нужны только свободным блокам и хранятся
+ * в первых байтах их данных, а не в заголовке.
  **/
 typedef struct mem_block {
     u32 size;
-    struct mem_block* next;
+    struct mem_block* prev_phys;    // физически предыдущий блок (boundary tag) для слияния за O(1)
+    u32 magic;    // MAGIC_NUMBER, проверяется в kfree
     u8 is_free;
-} __attribute__((packed)) mem_block_t;
+    u8 reserved;
+    u16 site;    // запись профилировщика (memprof), выделившая блок
+    // конец заголовка, дальше - данные блока
+    struct mem_block* next;    // следующий блок в корзине (только для свободных)
+    struct mem_block* prev;    // предыдущий блок в корзине (только для свободных)
+} mem_block_t;
+
+#define BLOCK_HEADER_SIZE BLOCK_SIZE
 
 /**
  * @brief Структура информации о памяти
@@ -36,7 +59,6 @@ typedef struct meminfo {
     u32 heap_size;
     u32 heap_current_end;
     u32 block_size;
-    mem_block_t* free_blocks;
     u32 total_used;
     u32 total_free;
     u32 block_count;
@@ -44,11 +66,22 @@ typedef struct meminfo {
     u32 free_count;
     u32 max_used;
     u32 leak_count;
+    u32 realloc_inplace;    // krealloc без копирования (уменьшение или рост за счет соседнего блока)
+    u32 realloc_copied;    // krealloc с выделением нового блока и копированием
+    u32 realloc_copied_bytes;    // сколько байт скопировано при таких krealloc
+    u32 shrink_runs;    // сколько раз куча обращалась к shrinker'ам
+    u32 shrink_reclaimed;    // сколько байт они вернули
+    u32 oom_count;    // выделения, завершившиеся NULL из-за нехватки памяти
+    u32 bin_blocks[MEM_BIN_COUNT];    // количество свободных блоков в каждой корзине
+    u32 bin_bytes[MEM_BIN_COUNT];    // суммарный размер свободных блоков в каждой корзине
 } meminfo_t;
 
 /**
  * @brief Получение информации о памяти
  *
+ * Работает за O(1): счетчики обновляются при каждом выделении и освобождении,
+ * полный обход кучи выполняет kmemverify.
+ *
  * @return meminfo_t
  **/
 meminfo_t get_meminfo();
@@ -60,40 +93,84 @@ meminfo_t get_meminfo();
 void get_freememaddr();
 
 /**
- * @brief Увеличение хипа
+ * @brief Увеличение хипа за счет следующих за ним физических фреймов
  *
  * @param size размер
- * @return int
+ * @return int 1 - куча выросла, 0 - фреймы за концом кучи заняты или отсутствуют
  **/
 int expand_heap(u32 size);
 
 /**
- * @brief Инициализация хипа
+ * @brief Инициализация хипа (после pmm_init)
  *
  **/
 void heap_init();
 
+/**
+ * @brief Аллокация памяти с выравниванием
+ *
+ * @param size размер
+ * @param alignment выравнивание (степень двойки)
+ * @return void*
+ **/
 void* kmalloc_aligned(u32 size, u32 alignment);
 
+/**
+ * @brief Освобождение памяти, выделенной kmalloc_aligned
+ *
+ * @param ptr указатель
+ **/
 void kfree_aligned(void* ptr);
 
 /**
  * @brief Аллокация памяти
  *
+ * Если подходящего блока нет и куча не может вырасти, сначала вызываются
+ * зарегистрированные shrinker'ы.
+ *
  * @param size размер
- * @return void*
+ * @return void* память или NULL, если ее не удалось найти даже после shrinker'ов
  **/
 void* kmalloc(u32 size);
 
 /**
  * @brief Реаллокация памяти
  *
+ * Блок растет на месте, если физически следующий блок свободен и достаточно велик
+ * (последний блок кучи - за счет расширения кучи); иначе данные копируются в новый блок.
+ *
  * @param ptr указатель
  * @param size размер
  * @return void*
  **/
 void* krealloc(void* ptr, u32 size);
 
+/**
+ * @brief Функция кэша, освобождающая память по запросу кучи
+ *
+ * Получает, сколько байт не хватает, освобождает (через kfree) то, что кэш может
+ * отдать прямо сейчас, и возвращает количество освобожденных байт (0 - нечего отдать).
+ * Вызывается изнутри kmalloc, поэтому не должна трогать объекты, которые сейчас используются.
+ **/
+typedef u32 (*mem_shrinker_t)(u32 wanted);
+
+/**
+ * @brief Регистрация shrinker'а
+ *
+ * @param name имя кэша (для статистики)
+ * @param shrink функция освобождения памяти
+ * @return int 1 - зарегистрирован, 0 - таблица заполнена
+ **/
+int mem_register_shrinker(const char* name, mem_shrinker_t shrink);
+
+/**
+ * @brief Обращение ко всем shrinker'ам по очереди, пока не наберется wanted байт
+ *
+ * @param wanted сколько байт нужно
+ * @return u32 сколько байт освобождено
+ **/
+u32 mem_shrink(u32 wanted);
+
 /**
  * @brief Освобождение памяти
  *
@@ -106,4 +183,21 @@ void kfree(void* ptr);
  **/
 void kmemdump();
 
+/**
+ * @brief Проверка целостности кучи: физическая цепочка блоков, boundary tags и корзины
+ *
+ * Полным обходом кучи пересчитывает занятые и свободные байты и число блоков
+ * и сверяет их со счетчиками, которые возвращает get_meminfo.
+ *
+ * @return int количество найденных ошибок (0 - куча согласована)
+ **/
+int kmemverify();
+
+/**
+ * @brief Режим самопроверки: kmemverify() после каждого слияния в kfree
+ *
+ * @param enabled 1 - включить, 0 - выключить
+ **/
+void heap_set_selfcheck(u8 enabled);
+
 #endif
@@ -0,0 +1,173 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS KKLIBC source code
+ *  File: kklibc/memprof.c
+ *  Title: Профилировщик выделений памяти по местам вызова
+ *	Description: Хэш-таблица фиксированного размера с открытой адресацией,
+ *	ключ - адрес возврата из kmalloc/krealloc. Номер записи хранится в
+ *	заголовке блока, поэтому kfree списывает живые байты с того места,
+ *	где блок был выделен.
+ * ----------------------------------------------------------------------------*/
+
+#include "memprof.h"
+
+#include "stdio.h"
+#include "stdlib.h"
+
+static memprof_site_t sites[MEMPROF_SITES];
+
+#define SITE_HASH(caller) ((((caller) >> 2) * 2654435761u) >> 24)    // 8 бит для 256 записей
+
+static u16 memprof_lookup(u32 caller) {
+    u32 index = SITE_HASH(caller) & (MEMPROF_SITES - 1);
+
+    for (u32 probe = 0; probe < MEMPROF_SITES; probe++, index = (index + 1) & (MEMPROF_SITES - 1)) {
+        if (index == MEMPROF_OVERFLOW) {
+            continue;
+        }
+        if (sites[index].caller == caller) {
+            return index;
+        }
+        if (sites[index].caller == 0) {
+            sites[index].caller = caller;
+            return index;
+        }
+    }
+
+    return MEMPROF_OVERFLOW;
+}
+
+u16 memprof_alloc(u32 caller, u32 size, u32 size_class) {
+    u16 index = memprof_lookup(caller);
+    memprof_site_t* site = &sites[index];
+
+    site->alloc_count++;
+    site->alloc_bytes += size;
+    site->live_blocks++;
+    site->live_bytes += size;
+    site->class_count[size_class]++;
+
+    return index;
+}
+
+void memprof_free(u16 site, u32 size) {
+    memprof_site_t* entry = &sites[site < MEMPROF_SITES ? site : MEMPROF_OVERFLOW];
+
+    entry->free_count++;
+    entry->free_bytes += size;
+    if (entry->live_blocks) {
+        entry->live_blocks--;
+    }
+    entry->live_bytes = entry->live_bytes > size ? entry->live_bytes - size : 0;
+}
+
+void memprof_resize(u16 site, u32 old_size, u32 new_size) {
+    memprof_site_t* entry = &sites[site < MEMPROF_SITES ? site : MEMPROF_OVERFLOW];
+
+    if (new_size >= old_size) {
+        entry->live_bytes += new_size - old_size;
+        entry->alloc_bytes += new_size - old_size;
+    } else {
+        entry->live_bytes = entry->live_bytes > old_size - new_size ? entry->live_bytes - (old_size - new_size) : 0;
+        entry->free_bytes += old_size - new_size;
+    }
+}
+
+void memprof_realloc(u32 caller) {
+    sites[memprof_lookup(caller)].realloc_count++;
+}
+
+void memprof_reset(u8 full) {
+    if (full) {
+        memset(sites, 0, sizeof(sites));
+        return;
+    }
+
+    for (u32 i = 0; i < MEMPROF_SITES; i++) {
+        memprof_site_t* site = &sites[i];
+
+        site->alloc_count = 0;
+        site->alloc_bytes = 0;
+        site->free_count = 0;
+        site->free_bytes = 0;
+        site->realloc_count = 0;
+        memset(site->class_count, 0, sizeof(site->class_count));
+    }
+}
+
+// самый частый класс размера места вызова
+static u32 memprof_main_class(memprof_site_t* site) {
+    u32 best = 0;
+
+    for (u32 i = 1; i < MEM_BIN_COUNT; i++) {
+        if (site->class_count[i] > site->class_count[best]) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+static void memprof_print_top(char* title, u8 by_bytes) {
+    u32 top[MEMPROF_TOP];
+    u32 count = 0;
+
+    // вставками держим MEMPROF_TOP лучших записей
+    for (u32 i = 0; i < MEMPROF_SITES; i++) {
+        u32 key = by_bytes ? sites[i].alloc_bytes : sites[i].alloc_count;
+        if (key == 0) {
+            continue;
+        }
+
+        u32 pos = count < MEMPROF_TOP ? count++ : MEMPROF_TOP;
+        while (pos > 0) {
+            memprof_site_t* prev = &sites[top[pos - 1]];
+            if ((by_bytes ? prev->alloc_bytes : prev->alloc_count) >= key) {
+                break;
+            }
+            if (pos < MEMPROF_TOP) {
+                top[pos] = top[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < MEMPROF_TOP) {
+            top[pos] = i;
+        }
+    }
+
+    printf("%s:\n", title);
+    printf("  %-10s %8s %10s %8s %10s %7s %s\n", "caller", "allocs", "bytes", "frees", "live", "reallc", "class");
+
+    for (u32 i = 0; i < count; i++) {
+        memprof_site_t* site = &sites[top[i]];
+        u32 size_class = memprof_main_class(site);
+
+        if (top[i] == MEMPROF_OVERFLOW) {
+            printf("  %-10s ", "(other)");
+        } else {
+            printf("  0x%-8x ", site->caller);
+        }
+        printf(
+            "%8d %10d %8d %10d %7d %d+\n",
+            site->alloc_count,
+            site->alloc_bytes,
+            site->free_count,
+            site->live_bytes,
+            site->realloc_count,
+            BLOCK_SIZE << size_class);
+    }
+}
+
+void memprof_dump() {
+    u32 used = 0;
+    u32 live = 0;
+
+    for (u32 i = 0; i < MEMPROF_SITES; i++) {
+        if (sites[i].caller || i == MEMPROF_OVERFLOW) {
+            live += sites[i].live_bytes;
+            used += sites[i].caller != 0;
+        }
+    }
+
+    printf("\nAllocation sites: %d of %d, live bytes: %d\n", used, MEMPROF_SITES - 1, live);
+    memprof_print_top("Top call sites by bytes", 1);
+    memprof_print_top("Top call sites by count", 0);
+}
@@ -0,0 +1,82 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS C Libraries source code
+ *  File: libc/memprof.h
+ *  Title: Профилировщик выделений памяти по местам вызова (заголовочный файл memprof.c)
+ *	Description: Статистика kmalloc/krealloc/kfree, сгруппированная по адресу
+ *	возврата вызывающей функции.
+ * ----------------------------------------------------------------------------*/
+
+#ifndef KKLIBC_MEMPROF_H
+#define KKLIBC_MEMPROF_H
+
+#include "ctypes.h"
+#include "mem.h"
+
+#define MEMPROF_SITES 256    // размер хэш-таблицы (степень двойки)
+#define MEMPROF_OVERFLOW 0    // запись для всех мест вызова, не поместившихся в таблицу
+#define MEMPROF_TOP 8    // сколько мест вызова выводит memprof_dump
+
+/**
+ * @brief Статистика одного места вызова
+ *
+ **/
+typedef struct memprof_site {
+    u32 caller;    // адрес возврата в вызывающий код (0 - свободная запись)
+    u32 alloc_count;
+    u32 alloc_bytes;
+    u32 free_count;
+    u32 free_bytes;
+    u32 realloc_count;
+    u32 live_blocks;
+    u32 live_bytes;
+    u32 class_count[MEM_BIN_COUNT];    // выделения по классам размеров (корзинам кучи)
+} memprof_site_t;
+
+/**
+ * @brief Учет выделения
+ *
+ * @param caller адрес возврата вызывающего кода
+ * @param size фактический размер блока
+ * @param size_class класс размера (индекс корзины)
+ * @return u16 номер записи, который хранится в заголовке блока до kfree
+ **/
+u16 memprof_alloc(u32 caller, u32 size, u32 size_class);
+
+/**
+ * @brief Учет освобождения
+ *
+ * @param site номер записи из заголовка блока
+ * @param size размер блока
+ **/
+void memprof_free(u16 site, u32 size);
+
+/**
+ * @brief Учет изменения размера блока на месте (krealloc без копирования)
+ *
+ * @param site номер записи из заголовка блока
+ * @param old_size прежний размер
+ * @param new_size новый размер
+ **/
+void memprof_resize(u16 site, u32 old_size, u32 new_size);
+
+/**
+ * @brief Учет вызова krealloc
+ *
+ * @param caller адрес возврата вызывающего кода
+ **/
+void memprof_realloc(u32 caller);
+
+/**
+ * @brief Сброс счетчиков
+ *
+ * @param full 1 - очистить таблицу полностью (при инициализации кучи),
+ * 0 - сбросить накопленные счетчики, сохранив места вызова и живые блоки
+ **/
+void memprof_reset(u8 full);
+
+/**
+ * @brief Вывод самых активных мест вызова по байтам и по количеству выделений
+ **/
+void memprof_dump();
+
+#endif
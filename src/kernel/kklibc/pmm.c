@@ -0,0 +1,243 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS KKLIBC source code
+ *  File: kklibc/pmm.c
+ *  Title: Менеджер физических страниц
+ *	Description: Один бит на 4 КБ фрейм (1 - занят). Свободными помечаются только
+ *	области E820_USABLE выше PMM_RESERVED_END, поэтому аллокатор никогда не
+ *	выдаст память, которой нет в машине.
+ * ----------------------------------------------------------------------------*/
+
+#include "pmm.h"
+
+#include "../drivers/screen.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+#define FRAME_INDEX(addr) ((addr) / PMM_FRAME_SIZE)
+#define BITMAP_WORDS (PMM_MAX_FRAMES / 32)
+#define MEMORY_LIMIT 0x100000000ULL    // 4 ГБ
+
+// Если BIOS не поддерживает E820, считаем, что памяти ровно столько,
+// сколько дает QEMU в Makefile (-m 16)
+#define PMM_FALLBACK_MEMORY 0x1000000
+
+static u32 bitmap[BITMAP_WORDS];
+static u32 frame_limit = 0;    // номер фрейма, выше которого памяти нет
+static u32 next_word = 0;    // с какого слова начинать поиск (next-fit)
+
+static e820_map_t memory_map;
+static pmminfo_t info;
+
+static inline u32 pmm_lowest_bit(u32 x) {
+    u32 r;
+    __asm__("bsf %1, %0" : "=r"(r) : "rm"(x));
+    return r;
+}
+
+static inline int frame_used(u32 frame) {
+    return (bitmap[frame / 32] >> (frame % 32)) & 1;
+}
+
+static void mark_used(u32 frame) {
+    if (!frame_used(frame)) {
+        bitmap[frame / 32] |= 1 << (frame % 32);
+        info.free_frames--;
+    }
+}
+
+static void mark_free(u32 frame) {
+    if (frame_used(frame)) {
+        bitmap[frame / 32] &= ~(1 << (frame % 32));
+        info.free_frames++;
+    }
+}
+
+// границы записи E820 в пределах 4 ГБ; 0 - запись целиком за пределами
+static int entry_bounds(e820_entry_t* entry, u64* start, u64* end) {
+    *start = entry->base;
+    *end = entry->base + entry->length;
+
+    if (*start >= MEMORY_LIMIT || *end <= *start) {
+        return 0;
+    }
+    if (*end > MEMORY_LIMIT) {
+        *end = MEMORY_LIMIT;
+    }
+    return 1;
+}
+
+void pmm_init(e820_map_t* map) {
+    memset(&info, 0, sizeof(info));
+    memset(bitmap, 0xFF, sizeof(bitmap));
+    frame_limit = 0;
+    next_word = 0;
+
+    if (map && map->count > 0) {
+        memory_map.count = map->count > E820_MAX_ENTRIES ? E820_MAX_ENTRIES : map->count;
+        memcpy(memory_map.entries, map->entries, memory_map.count * sizeof(e820_entry_t));
+    } else {
+        printf_colored("E820 memory map is not available, assuming 16 MB\n", RED_ON_BLACK);
+        memory_map.count = 2;
+        memory_map.entries[0] = (e820_entry_t) { 0, 0x9F000, E820_USABLE, 1 };
+        memory_map.entries[1] = (e820_entry_t) { 0x100000, PMM_FALLBACK_MEMORY - 0x100000, E820_USABLE, 1 };
+    }
+    info.map_entries = memory_map.count;
+
+    // 1. Освобождаем доступные области (только целые фреймы)
+    for (u32 i = 0; i < memory_map.count; i++) {
+        e820_entry_t* entry = &memory_map.entries[i];
+        u64 start, end;
+
+        if (entry->type != E820_USABLE || !entry_bounds(entry, &start, &end)) {
+            continue;
+        }
+
+        u32 first = (u32)((start + PMM_FRAME_SIZE - 1) >> 12);
+        u32 last = (u32)(end >> 12);
+
+        for (u32 frame = first; frame < last; frame++) {
+            mark_free(frame);
+        }
+
+        info.total_memory += (u32)(end - start);
+        if (start < PMM_RESERVED_END) {
+            info.reserved_memory += (u32)((end < PMM_RESERVED_END ? end : PMM_RESERVED_END) - start);
+        }
+        if (last > frame_limit) {
+            frame_limit = last;
+        }
+    }
+
+    // 2. Области других типов могут перекрывать доступные - они важнее
+    for (u32 i = 0; i < memory_map.count; i++) {
+        e820_entry_t* entry = &memory_map.entries[i];
+        u64 start, end;
+
+        if (entry->type == E820_USABLE || !entry_bounds(entry, &start, &end)) {
+            continue;
+        }
+
+        u32 last = (u32)((end + PMM_FRAME_SIZE - 1) >> 12);
+        for (u32 frame = (u32)(start >> 12); frame < last && frame < frame_limit; frame++) {
+            mark_used(frame);
+        }
+    }
+
+    // 3. Память ядра
+    for (u32 frame = 0; frame < FRAME_INDEX(PMM_RESERVED_END) && frame < frame_limit; frame++) {
+        mark_used(frame);
+    }
+
+    info.total_frames = info.free_frames;
+    info.free_memory = info.free_frames * PMM_FRAME_SIZE;
+
+    printf(
+        "Physical memory: %d KB usable, %d frames free (%d entries in E820 map)\n",
+        info.total_memory / KB,
+        info.free_frames,
+        info.map_entries);
+}
+
+u32 pmm_alloc_frame() {
+    u32 words = (frame_limit + 31) / 32;
+    if (words == 0) {
+        return 0;
+    }
+
+    for (u32 n = 0; n < words; n++) {
+        u32 word = (next_word + n) % words;
+
+        if (bitmap[word] != 0xFFFFFFFF) {
+            u32 frame = word * 32 + pmm_lowest_bit(~bitmap[word]);
+            if (frame >= frame_limit) {
+                continue;
+            }
+
+            mark_used(frame);
+            next_word = word;
+            return frame * PMM_FRAME_SIZE;
+        }
+    }
+
+    return 0;
+}
+
+void pmm_free_frame(u32 addr) {
+    u32 frame = FRAME_INDEX(addr);
+
+    if (frame < FRAME_INDEX(PMM_RESERVED_END) || frame >= frame_limit) {
+        printf("ERROR: Invalid frame free: 0x%x\n", addr);
+        return;
+    }
+    if (!frame_used(frame)) {
+        printf("WARNING: Double frame free at 0x%x\n", addr);
+        return;
+    }
+
+    mark_free(frame);
+    if (frame / 32 < next_word) {
+        next_word = frame / 32;
+    }
+}
+
+int pmm_claim_range(u32 addr, u32 size) {
+    u32 first = FRAME_INDEX(addr);
+    u32 count = FRAME_INDEX(size);
+
+    if (first + count > frame_limit || first + count < first) {
+        return 0;
+    }
+
+    for (u32 frame = first; frame < first + count; frame++) {
+        if (frame_used(frame)) {
+            return 0;
+        }
+    }
+
+    for (u32 frame = first; frame < first + count; frame++) {
+        mark_used(frame);
+    }
+    return 1;
+}
+
+void pmm_release_range(u32 addr, u32 size) {
+    for (u32 offset = 0; offset < size; offset += PMM_FRAME_SIZE) {
+        pmm_free_frame(addr + offset);
+    }
+}
+
+pmminfo_t pmm_get_info() {
+    info.free_memory = info.free_frames * PMM_FRAME_SIZE;
+    info.memory_top = frame_limit >= PMM_MAX_FRAMES ? 0xFFFFF000 : frame_limit * PMM_FRAME_SIZE;
+    return info;
+}
+
+void pmm_dump() {
+    static char* type_names[] = { "unknown", "usable", "reserved", "ACPI reclaimable", "ACPI NVS", "bad" };
+    pmminfo_t current = pmm_get_info();
+
+    printf("E820 memory map (%d entries):\n", memory_map.count);
+
+    for (u32 i = 0; i < memory_map.count; i++) {
+        e820_entry_t* entry = &memory_map.entries[i];
+        u32 type = entry->type <= E820_BAD ? entry->type : 0;
+
+        if (entry->base >= MEMORY_LIMIT) {
+            printf("  above 4 GB: %d KB %s\n", (u32)(entry->length >> 10), type_names[type]);
+            continue;
+        }
+        printf(
+            "  0x%x - 0x%x %s\n",
+            (u32)entry->base,
+            (u32)(entry->base + entry->length - 1),
+            type_names[type]);
+    }
+
+    printf(
+        "Usable: %d KB (kernel area: %d KB), frames: %d free of %d (%d KB free)\n",
+        current.total_memory / KB,
+        current.reserved_memory / KB,
+        current.free_frames,
+        current.total_frames,
+        current.free_memory / KB);
+}
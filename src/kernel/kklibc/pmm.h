@@ -0,0 +1,110 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS C Libraries source code
+ *  File: libc/pmm.h
+ *  Title: Менеджер физических страниц (заголовочный файл pmm.c)
+ *	Description: Битовая карта 4 КБ фреймов, построенная по карте памяти BIOS E820.
+ * ----------------------------------------------------------------------------*/
+
+#ifndef KKLIBC_PMM_H
+#define KKLIBC_PMM_H
+
+#include "ctypes.h"
+
+#define PMM_FRAME_SIZE 4096
+#define PMM_MAX_FRAMES 0x100000    // 4 ГБ / 4 КБ - все, что адресуется без PAE
+#define PMM_RESERVED_END 0x200000    // ниже лежат ядро, BIOS, стек и область для load
+
+#define E820_MAX_ENTRIES 32    // столько записей сохраняет загрузчик (bootloader/memmap.asm)
+
+#define E820_USABLE 1
+#define E820_RESERVED 2
+#define E820_ACPI_RECLAIMABLE 3
+#define E820_ACPI_NVS 4
+#define E820_BAD 5
+
+/**
+ * @brief Запись карты памяти E820 (в формате, который возвращает BIOS)
+ *
+ **/
+typedef struct {
+    u64 base;
+    u64 length;
+    u32 type;
+    u32 acpi;
+} __attribute__((packed)) e820_entry_t;
+
+/**
+ * @brief Карта памяти, собранная загрузчиком
+ *
+ **/
+typedef struct {
+    u16 count;
+    u16 reserved;
+    e820_entry_t entries[E820_MAX_ENTRIES];
+} __attribute__((packed)) e820_map_t;
+
+/**
+ * @brief Статистика физической памяти
+ *
+ **/
+typedef struct pmminfo {
+    u32 total_memory;    // вся доступная (E820_USABLE) память в байтах
+    u32 reserved_memory;    // доступная память ниже PMM_RESERVED_END (ядро и BIOS)
+    u32 free_memory;    // свободные фреймы в байтах
+    u32 memory_top;    // конец самой старшей доступной области (кратно PMM_FRAME_SIZE)
+    u32 total_frames;    // фреймы, которыми управляет аллокатор
+    u32 free_frames;
+    u32 map_entries;
+} pmminfo_t;
+
+/**
+ * @brief Инициализация аллокатора по карте памяти E820
+ *
+ * @param map карта памяти от загрузчика (если записей нет - используется запасной вариант 16 МБ)
+ **/
+void pmm_init(e820_map_t* map);
+
+/**
+ * @brief Выделение одного свободного фрейма
+ *
+ * @return u32 физический адрес фрейма или 0, если память закончилась
+ **/
+u32 pmm_alloc_frame();
+
+/**
+ * @brief Освобождение фрейма
+ *
+ * @param addr физический адрес фрейма
+ **/
+void pmm_free_frame(u32 addr);
+
+/**
+ * @brief Захват конкретного диапазона фреймов (например, для роста кучи)
+ *
+ * @param addr начало диапазона (кратно PMM_FRAME_SIZE)
+ * @param size размер в байтах (кратно PMM_FRAME_SIZE)
+ * @return int 1 - все фреймы были свободны и теперь заняты, 0 - диапазон недоступен
+ **/
+int pmm_claim_range(u32 addr, u32 size);
+
+/**
+ * @brief Освобождение диапазона фреймов
+ *
+ * @param addr начало диапазона (кратно PMM_FRAME_SIZE)
+ * @param size размер в байтах (кратно PMM_FRAME_SIZE)
+ **/
+void pmm_release_range(u32 addr, u32 size);
+
+/**
+ * @brief Получение статистики физической памяти
+ *
+ * @return pmminfo_t
+ **/
+pmminfo_t pmm_get_info();
+
+/**
+ * @brief Вывод карты памяти E820 и статистики фреймов
+ **/
+void pmm_dump();
+
+#endif
@@ -0,0 +1,247 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS KKLIBC source code
+ *  File: kklibc/slab.c
+ *  Title: Slab-аллокатор объектов фиксированного размера
+ *	Description: Кэш берет у kmalloc целый slab и нарезает его на объекты.
+ *	Свободные объекты связаны в список прямо внутри себя, поэтому у объекта
+ *	нет собственного заголовка, а повторное выделение стоит O(1). Slab выровнен
+ *	на свой размер (степень двойки), поэтому kfree находит его маской адреса.
+ * ----------------------------------------------------------------------------*/
+
+#include "slab.h"
+
+#include "mem.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+/* Все созданные кэши */
+static kmem_cache_t* caches = NULL;
+
+#define SLAB_HEADER_SIZE ((sizeof(kmem_slab_t) + KMEM_OBJ_ALIGN - 1) & ~(KMEM_OBJ_ALIGN - 1))
+#define SLAB_OBJECTS(slab) ((u8*)(slab) + SLAB_HEADER_SIZE)
+#define SLAB_OF(cache, obj) ((kmem_slab_t*)((u32)(obj) & ~((cache)->slab_size - 1)))
+
+static void slab_list_insert(kmem_slab_t** list, kmem_slab_t* slab) {
+    slab->prev = NULL;
+    slab->next = *list;
+    if (*list) {
+        (*list)->prev = slab;
+    }
+    *list = slab;
+}
+
+static void slab_list_remove(kmem_slab_t** list, kmem_slab_t* slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *list = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+    slab->next = slab->prev = NULL;
+}
+
+static kmem_slab_t* slab_create(kmem_cache_t* cache) {
+    kmem_slab_t* slab = (kmem_slab_t*)kmalloc_aligned(cache->slab_size, cache->slab_size);
+    if (!slab) {
+        return NULL;
+    }
+
+    slab->cache = cache;
+    slab->in_use = 0;
+    slab->full = 0;
+    slab->free_list = NULL;
+
+    // нарезаем объекты с конца, чтобы первым выдавался объект с младшим адресом
+    u8* objects = SLAB_OBJECTS(slab);
+    for (u32 i = cache->objects_per_slab; i > 0; i--) {
+        void* obj = objects + (i - 1) * cache->object_size;
+        *(void**)obj = slab->free_list;
+        slab->free_list = obj;
+    }
+
+    cache->slab_count++;
+    cache->empty_slabs++;
+    slab_list_insert(&cache->partial, slab);
+
+    return slab;
+}
+
+static void slab_destroy(kmem_cache_t* cache, kmem_slab_t* slab) {
+    slab_list_remove(&cache->partial, slab);
+    cache->slab_count--;
+    cache->empty_slabs--;
+    kfree(slab);
+}
+
+// slab объекта - маской адреса; чужой указатель отсекается по владельцу и границе объекта
+static kmem_slab_t* slab_find(kmem_cache_t* cache, void* obj) {
+    kmem_slab_t* slab = SLAB_OF(cache, obj);
+    u32 start = (u32)SLAB_OBJECTS(slab);
+    u32 end = start + cache->objects_per_slab * cache->object_size;
+
+    if (slab->cache != cache || (u32)obj < start || (u32)obj >= end) {
+        return NULL;
+    }
+    if (((u32)obj - start) % cache->object_size != 0) {
+        return NULL;
+    }
+    return slab;
+}
+
+// shrinker: при нехватке памяти отдаем куче все пустые slab'ы, включая запасные
+static u32 slab_shrinker(u32 wanted) {
+    u32 reclaimed = 0;
+
+    for (kmem_cache_t* cache = caches; cache && reclaimed < wanted; cache = cache->next) {
+        reclaimed += kmem_cache_shrink(cache);
+    }
+    return reclaimed;
+}
+
+kmem_cache_t* kmem_cache_create(const char* name, u32 size, kmem_ctor_t ctor) {
+    if (size == 0) {
+        return NULL;
+    }
+
+    if (!caches) {
+        mem_register_shrinker("slab", slab_shrinker);
+    }
+
+    kmem_cache_t* cache = (kmem_cache_t*)kmalloc(sizeof(kmem_cache_t));
+    if (!cache) {
+        return NULL;
+    }
+
+    memset(cache, 0, sizeof(kmem_cache_t));
+    strncpy(cache->name, name, KMEM_CACHE_NAME_LEN - 1);
+    cache->name[KMEM_CACHE_NAME_LEN - 1] = '\0';
+
+    // свободный объект хранит в себе ссылку на следующий
+    if (size < sizeof(void*)) {
+        size = sizeof(void*);
+    }
+    cache->object_size = (size + KMEM_OBJ_ALIGN - 1) & ~(KMEM_OBJ_ALIGN - 1);
+    cache->ctor = ctor;
+
+    // размер slab'а - степень двойки, чтобы его начало находилось маской адреса объекта
+    cache->slab_size = KMEM_SLAB_SIZE;
+    while (cache->slab_size - SLAB_HEADER_SIZE < cache->object_size) {
+        cache->slab_size <<= 1;
+    }
+    cache->objects_per_slab = (cache->slab_size - SLAB_HEADER_SIZE) / cache->object_size;
+
+    cache->next = caches;
+    caches = cache;
+
+    return cache;
+}
+
+void* kmem_cache_alloc(kmem_cache_t* cache) {
+    if (!cache) {
+        return NULL;
+    }
+
+    kmem_slab_t* slab = cache->partial;
+    if (!slab) {
+        slab = slab_create(cache);
+        if (!slab) {
+            return NULL;
+        }
+    }
+
+    void* obj = slab->free_list;
+    slab->free_list = *(void**)obj;
+
+    if (slab->in_use++ == 0) {
+        cache->empty_slabs--;
+    }
+
+    if (!slab->free_list) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_insert(&cache->full, slab);
+        slab->full = 1;
+    }
+
+    cache->alloc_count++;
+    cache->active_objects++;
+    if (cache->active_objects > cache->max_active) {
+        cache->max_active = cache->active_objects;
+    }
+
+    // ссылка свободного списка затерла начало объекта - конструируем при каждой выдаче
+    if (cache->ctor) {
+        cache->ctor(obj);
+    }
+
+    return obj;
+}
+
+void kmem_cache_free(kmem_cache_t* cache, void* obj) {
+    if (!cache || !obj) {
+        return;
+    }
+
+    kmem_slab_t* slab = slab_find(cache, obj);
+    if (!slab) {
+        printf("ERROR: Object 0x%x does not belong to cache %s\n", (u32)obj, cache->name);
+        return;
+    }
+
+    // полный slab снова становится частично свободным
+    if (slab->full) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_insert(&cache->partial, slab);
+        slab->full = 0;
+    }
+
+    *(void**)obj = slab->free_list;
+    slab->free_list = obj;
+
+    cache->free_count++;
+    cache->active_objects--;
+
+    if (--slab->in_use == 0) {
+        cache->empty_slabs++;
+
+        // один пустой slab держим про запас, остальные возвращаем в кучу
+        if (cache->empty_slabs > 1) {
+            slab_destroy(cache, slab);
+        }
+    }
+}
+
+u32 kmem_cache_shrink(kmem_cache_t* cache) {
+    u32 reclaimed = 0;
+    kmem_slab_t* slab = cache->partial;
+
+    while (slab && cache->empty_slabs) {
+        kmem_slab_t* next = slab->next;
+        if (slab->in_use == 0) {
+            reclaimed += cache->slab_size;
+            slab_destroy(cache, slab);
+        }
+        slab = next;
+    }
+
+    return reclaimed;
+}
+
+void kmem_cache_dump() {
+    printf("\nSlab caches:\n");
+
+    for (kmem_cache_t* cache = caches; cache; cache = cache->next) {
+        printf(
+            "%-12s obj=%d per_slab=%d slabs=%d (empty %d) active=%d max=%d allocs=%d frees=%d\n",
+            cache->name,
+            cache->object_size,
+            cache->objects_per_slab,
+            cache->slab_count,
+            cache->empty_slabs,
+            cache->active_objects,
+            cache->max_active,
+            cache->alloc_count,
+            cache->free_count);
+    }
+}
@@ -0,0 +1,97 @@
+/*------------------------------------------------------------------------------
+ *  Kintsugi OS C Libraries source code
+ *  File: libc/slab.h
+ *  Title: Slab-аллокатор объектов фиксированного размера (заголовочный файл slab.c)
+ *	Description: Кэши объектов поверх kmalloc: без заголовка на каждый объект,
+ *	со своими списками свободных объектов и статистикой.
+ * ----------------------------------------------------------------------------*/
+
+#ifndef KKLIBC_SLAB_H
+#define KKLIBC_SLAB_H
+
+#include "ctypes.h"
+
+#define KMEM_SLAB_SIZE 4096    // наименьший размер slab'а; под крупные объекты - следующая степень двойки
+#define KMEM_OBJ_ALIGN 8    // выравнивание объектов внутри slab'а
+#define KMEM_CACHE_NAME_LEN 16
+
+/**
+ * @brief Конструктор объекта: вызывается в kmem_cache_alloc перед каждой выдачей объекта
+ *
+ **/
+typedef void (*kmem_ctor_t)(void* obj);
+
+/**
+ * @brief Slab: непрерывный кусок памяти из kmalloc, нарезанный на объекты одного размера
+ *
+ **/
+typedef struct kmem_slab {
+    struct kmem_slab* next;
+    struct kmem_slab* prev;
+    struct kmem_cache* cache;    // владелец (проверка указателя в kmem_cache_free)
+    void* free_list;    // односвязный список свободных объектов (ссылка лежит в самом объекте)
+    u32 in_use;    // количество выданных объектов
+    u8 full;    // 1 - slab в списке full
+} kmem_slab_t;
+
+/**
+ * @brief Кэш объектов
+ *
+ **/
+typedef struct kmem_cache {
+    char name[KMEM_CACHE_NAME_LEN];
+    u32 object_size;    // размер объекта с учетом выравнивания
+    u32 objects_per_slab;
+    u32 slab_size;    // степень двойки, slab выровнен на свой размер
+    kmem_ctor_t ctor;
+    kmem_slab_t* partial;    // slab'ы, в которых есть свободные объекты
+    kmem_slab_t* full;    // полностью занятые slab'ы
+    u32 empty_slabs;    // полностью свободные slab'ы (лежат в partial)
+    u32 slab_count;
+    u32 active_objects;
+    u32 max_active;
+    u32 alloc_count;
+    u32 free_count;
+    struct kmem_cache* next;    // список всех кэшей (для kmem_cache_dump)
+} kmem_cache_t;
+
+/**
+ * @brief Создание кэша объектов
+ *
+ * @param name имя кэша (для статистики)
+ * @param size размер объекта
+ * @param ctor конструктор объекта или NULL
+ * @return kmem_cache_t* кэш или NULL, если не хватило памяти
+ **/
+kmem_cache_t* kmem_cache_create(const char* name, u32 size, kmem_ctor_t ctor);
+
+/**
+ * @brief Выделение объекта из кэша
+ *
+ * @param cache кэш
+ * @return void* объект или NULL
+ **/
+void* kmem_cache_alloc(kmem_cache_t* cache);
+
+/**
+ * @brief Возврат объекта в кэш
+ *
+ * @param cache кэш, из которого был выделен объект
+ * @param obj объект
+ **/
+void kmem_cache_free(kmem_cache_t* cache, void* obj);
+
+/**
+ * @brief Возврат в кучу всех пустых slab'ов кэша (в том числе запасного)
+ *
+ * @param cache кэш
+ * @return u32 сколько байт возвращено
+ **/
+u32 kmem_cache_shrink(kmem_cache_t* cache);
+
+/**
+ * @brief Вывод статистики всех кэшей
+ **/
+void kmem_cache_dump();
+
+#endif
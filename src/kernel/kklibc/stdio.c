@@ -13,16 +13,71 @@
 #include "stdlib.h"
 
 #define PRINTF_BUF_SIZE 1024
-static char printf_buf[PRINTF_BUF_SIZE];
+#define PRINTF_CHUNK 128    // порция потокового printf (буфер на стеке)
+#define PRINTF_DEFAULT_COLOR (-1)    // цвет kprint по умолчанию
+
+static char printf_buf[PRINTF_BUF_SIZE];    // только для printf_at
+
+/* Поток форматирования. Символы копятся в buf размером size; когда он заполнен,
+ * emit сбрасывает порцию (printf - в терминал), а без emit остаток отбрасывается
+ * (snprintf обрезает строку). size == 0 - буфер без ограничения (sprintf). */
+typedef struct format_stream {
+    char* buf;
+    u32 size;
+    u32 pos;
+    void (*emit)(struct format_stream* stream);
+    int color;
+} format_stream_t;
+
+static inline int stream_full(format_stream_t* stream) {
+    return stream->size && !stream->emit && stream->pos >= stream->size - 1;
+}
 
-unsigned int format_string_core(char* buf, unsigned int size, char* fmt, va_list args) {
-    unsigned int i = 0;
-    char num_buf[32];
-    const char* s;
+static inline void stream_putc(format_stream_t* stream, char c) {
+    if (stream->size && stream->pos >= stream->size - 1) {
+        if (!stream->emit) {
+            return;
+        }
+        stream->emit(stream);
+    }
+    stream->buf[stream->pos++] = c;
+}
+
+static void stream_pad(format_stream_t* stream, char c, int count) {
+    while (count-- > 0) {
+        stream_putc(stream, c);
+    }
+}
+
+// число: знак/префикс, выравнивание по ширине (нули ставятся после знака и префикса)
+static void stream_number(format_stream_t* stream, const char* digits, int len, const char* prefix, int width,
+                          int left_align, int zero_pad) {
+    int prefix_len = prefix ? strlen((char*)prefix) : 0;
+    int padding = width - len - prefix_len;
+
+    if (!left_align && !zero_pad) {
+        stream_pad(stream, ' ', padding);
+    }
+    while (prefix_len-- > 0) {
+        stream_putc(stream, *prefix++);
+    }
+    if (!left_align && zero_pad) {
+        stream_pad(stream, '0', padding);
+    }
+    while (len-- > 0) {
+        stream_putc(stream, *digits++);
+    }
+    if (left_align) {
+        stream_pad(stream, ' ', padding);
+    }
+}
+
+static void format_to_stream(format_stream_t* stream, char* fmt, va_list args) {
+    char num_buf[24];
 
-    while (*fmt && (size == 0 || i < size - 1)) {
+    while (*fmt && !stream_full(stream)) {
         if (*fmt != '%') {
-            buf[i++] = *fmt++;
+            stream_putc(stream, *fmt++);
             continue;
         }
 
@@ -32,10 +87,18 @@ unsigned int format_string_core(char* buf, unsigned int size, char* fmt, va_list
         int width = 0;
         int zero_pad = 0;
         int hex_prefix = 0;
-
-        if (*fmt == '-') {
-            left_align = 1;
-            fmt++;
+        int long_long = 0;
+
+        for (;; fmt++) {
+            if (*fmt == '-') {
+                left_align = 1;
+            } else if (*fmt == '0') {
+                zero_pad = 1;
+            } else if (*fmt == '#') {
+                hex_prefix = 1;
+            } else {
+                break;
+            }
         }
 
         while (*fmt >= '0' && *fmt <= '9') {
@@ -43,144 +106,58 @@ unsigned int format_string_core(char* buf, unsigned int size, char* fmt, va_list
             fmt++;
         }
 
-        if (*fmt == '0') {
-            zero_pad = 1;
+        // длина: l - 32 бита (как int на i386), ll - 64 бита
+        if (*fmt == 'l') {
             fmt++;
-        }
-
-        if (width > 0 && fmt[0] == '#' && fmt[1] == 'x') {
-            hex_prefix = 1;
-            fmt += 2;
+            if (*fmt == 'l') {
+                long_long = 1;
+                fmt++;
+            }
         }
 
         switch (*fmt) {
             case 'd': {
-                int num = va_arg(args, int);
-                int negative = 0;
-                unsigned int unum;
-                int digits = 0;
-
-                if (num < 0) {
-                    negative = 1;
-                    unum = (unsigned int)(-num);
-                } else {
-                    unum = (unsigned int)num;
-                }
-
-                do {
-                    num_buf[digits++] = '0' + (unum % 10);
-                    unum /= 10;
-                } while (unum > 0);
-
-                if (negative) {
-                    num_buf[digits++] = '-';
-                }
+                s64 num = long_long ? va_arg(args, s64) : va_arg(args, int);
+                u64 unum = num < 0 ? -(u64)num : (u64)num;
+                int len = utoa_dec(unum, num_buf);
 
-                int total_digits = digits;
-                int actual_digits = total_digits;
-
-                if (!left_align && width > total_digits) {
-                    int padding = width - total_digits;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = zero_pad ? '0' : ' ';
-                    }
-                }
+                stream_number(stream, num_buf, len, num < 0 ? "-" : NULL, width, left_align, zero_pad);
+                break;
+            }
 
-                while (actual_digits-- > 0 && (size == 0 || i < size - 1)) {
-                    buf[i++] = num_buf[actual_digits];
-                }
+            case 'u': {
+                u64 num = long_long ? va_arg(args, u64) : va_arg(args, unsigned int);
+                int len = utoa_dec(num, num_buf);
 
-                if (left_align && width > total_digits) {
-                    int padding = width - total_digits;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
-                }
+                stream_number(stream, num_buf, len, NULL, width, left_align, zero_pad);
                 break;
             }
 
             case 'x': {
-                unsigned int num = va_arg(args, unsigned int);
-                const char* hex_digits = "0123456789abcdef";
-                int digits = 0;
-                int total_len = 0;
-
-                unsigned int temp = num;
-                do {
-                    digits++;
-                    temp >>= 4;
-                } while (temp > 0);
-
-                if (hex_prefix && num != 0) {
-                    total_len = digits + 2;
-                } else {
-                    total_len = digits;
-                }
+                u64 num = long_long ? va_arg(args, u64) : va_arg(args, unsigned int);
+                int len = utoa_hex(num, num_buf);
 
-                if (!left_align && width > total_len) {
-                    int padding = width - total_len;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = zero_pad ? '0' : ' ';
-                    }
-                }
-
-                if (hex_prefix && num != 0) {
-                    if (size == 0 || i < size - 1) {
-                        buf[i++] = '0';
-                    }
-                    if (size == 0 || i < size - 1) {
-                        buf[i++] = 'x';
-                    }
-                }
-
-                int idx = digits;
-                while (idx-- > 0) {
-                    int shift = idx * 4;
-                    char hex_char = hex_digits[(num >> shift) & 0xF];
-                    if (size == 0 || i < size - 1) {
-                        buf[i++] = hex_char;
-                    }
-                }
-
-                if (left_align && width > total_len) {
-                    int padding = width - total_len;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
-                }
+                stream_number(
+                    stream, num_buf, len, (hex_prefix && num != 0) ? "0x" : NULL, width, left_align, zero_pad);
                 break;
             }
 
             case 's': {
-                s = va_arg(args, char*);
+                const char* s = va_arg(args, char*);
                 if (!s) {
                     s = "(null)";
                 }
 
-                const char* p = s;
-                int len = 0;
-                while (*p++) {
-                    len++;
-                }
-
-                p = s;
+                int len = strlen((char*)s);
 
-                if (!left_align && width > len) {
-                    int padding = width - len;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
+                if (!left_align) {
+                    stream_pad(stream, ' ', width - len);
                 }
-
-                while (*p && (size == 0 || i < size - 1)) {
-                    buf[i++] = *p++;
+                while (*s) {
+                    stream_putc(stream, *s++);
                 }
-
-                if (left_align && width > len) {
-                    int padding = width - len;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
+                if (left_align) {
+                    stream_pad(stream, ' ', width - len);
                 }
                 break;
             }
@@ -188,132 +165,99 @@ unsigned int format_string_core(char* buf, unsigned int size, char* fmt, va_list
             case 'c': {
                 char c = (char)va_arg(args, int);
 
-                if (!left_align && width > 1) {
-                    int padding = width - 1;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
+                if (!left_align) {
+                    stream_pad(stream, ' ', width - 1);
                 }
-
-                if (size == 0 || i < size - 1) {
-                    buf[i++] = c;
-                }
-
-                if (left_align && width > 1) {
-                    int padding = width - 1;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
+                stream_putc(stream, c);
+                if (left_align) {
+                    stream_pad(stream, ' ', width - 1);
                 }
                 break;
             }
 
-            case 'u': {
-                unsigned int num = va_arg(args, unsigned int);
-                int digits = 0;
-
-                do {
-                    num_buf[digits++] = '0' + (num % 10);
-                    num /= 10;
-                } while (num > 0);
+            case '%':
+                stream_putc(stream, '%');
+                break;
 
-                int total_digits = digits;
+            default: {
+                int len = *fmt != '\0' ? 2 : 1;
 
-                if (!left_align && width > total_digits) {
-                    int padding = width - total_digits;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = zero_pad ? '0' : ' ';
-                    }
+                if (!left_align) {
+                    stream_pad(stream, ' ', width - len);
                 }
-
-                while (total_digits-- > 0 && (size == 0 || i < size - 1)) {
-                    buf[i++] = num_buf[total_digits];
+                stream_putc(stream, '%');
+                if (*fmt != '\0') {
+                    stream_putc(stream, *fmt);
                 }
-
-                if (left_align && width > digits) {
-                    int padding = width - digits;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
+                if (left_align) {
+                    stream_pad(stream, ' ', width - len);
                 }
                 break;
             }
+        }
 
-            default: {
-                int len = 1;
-                if (*fmt != '\0') {
-                    len = 2;
-                }
+        if (*fmt) {    // одиночный '%' в конце строки
+            fmt++;
+        }
+    }
+}
 
-                if (!left_align && width > len) {
-                    int padding = width - len;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
-                }
+unsigned int format_string_core(char* buf, unsigned int size, char* fmt, va_list args) {
+    format_stream_t stream = { .buf = buf, .size = size, .pos = 0, .emit = NULL, .color = 0 };
 
-                if (size == 0 || i < size - 1) {
-                    buf[i++] = '%';
-                }
-                if (*fmt != '\0' && (size == 0 || i < size - 1)) {
-                    buf[i++] = *fmt;
-                }
+    format_to_stream(&stream, fmt, args);
+    buf[stream.pos] = '\0';
 
-                if (left_align && width > len) {
-                    int padding = width - len;
-                    while (padding-- > 0 && (size == 0 || i < size - 1)) {
-                        buf[i++] = ' ';
-                    }
-                }
-                break;
-            }
-        }
-        fmt++;
+    return stream.pos;
+}
+
+// порция printf: в терминал без перерисовки (ее объединяет терминал), на экран - через kprint
+static void printf_emit(format_stream_t* stream) {
+    if (stream->pos == 0) {
+        return;
     }
 
-    if (size == 0 || i < size) {
-        buf[i] = '\0';
-    } else if (size > 0) {
-        buf[size - 1] = '\0';
+    if (IS_TERMINAL_MODE()) {
+        u8 color = stream->color == PRINTF_DEFAULT_COLOR ? terminal_get_color() : stream->color;
+        terminal_write(stream->buf, stream->pos, color);
+    } else {
+        stream->buf[stream->pos] = '\0';
+        if (stream->color == PRINTF_DEFAULT_COLOR) {
+            kprint(stream->buf);
+        } else {
+            kprint_colored(stream->buf, stream->color);
+        }
     }
 
-    return i;
+    stream->pos = 0;
 }
 
-static void format_string(char* buf, char* fmt, va_list args) {
-    format_string_core(buf, 0, fmt, args);
+static void printf_stream(char* fmt, int color, va_list args) {
+    char chunk[PRINTF_CHUNK];
+    format_stream_t stream = { .buf = chunk, .size = PRINTF_CHUNK, .pos = 0, .emit = printf_emit, .color = color };
+
+    format_to_stream(&stream, fmt, args);
+    printf_emit(&stream);
 }
 
 void printf(char* fmt, ...) {
     va_list args;
     va_start(args, fmt);
-    format_string(printf_buf, fmt, args);
+    printf_stream(fmt, PRINTF_DEFAULT_COLOR, args);
     va_end(args);
-
-    if (IS_TERMINAL_MODE()) {
-        terminal_print(printf_buf);
-    } else {
-        kprint(printf_buf);
-    }
 }
 
 void printf_colored(char* fmt, int color, ...) {
     va_list args;
     va_start(args, color);
-    format_string(printf_buf, fmt, args);
+    printf_stream(fmt, color, args);
     va_end(args);
-
-    if (IS_TERMINAL_MODE()) {
-        terminal_print_colored(printf_buf, color);
-    } else {
-        kprint_colored(printf_buf, color);
-    }
 }
 
 void printf_at(char* fmt, int col, int row, int color, ...) {
     va_list args;
     va_start(args, color);
-    format_string(printf_buf, fmt, args);
+    format_string_core(printf_buf, PRINTF_BUF_SIZE, fmt, args);
     va_end(args);
 
     if (IS_TERMINAL_MODE()) {
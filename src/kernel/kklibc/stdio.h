@@ -16,11 +16,23 @@ typedef char* va_list;
 #define va_arg(ap, type) (*(type*)((ap += sizeof(type)) - sizeof(type)))
 #define va_end(ap) (ap = (va_list)0)
 
+/**
+ * @brief Форматирование в буфер
+ *
+ * @param buf буфер
+ * @param size размер буфера с завершающим нулем (0 - без ограничения)
+ * @param fmt строка формата
+ * @param args аргументы
+ * @return unsigned int количество записанных символов
+ **/
 unsigned int format_string_core(char* buf, unsigned int size, char* fmt, va_list args);
 
 /**
  * @brief Стандартный форматированный вывод
  *
+ * Вывод не ограничен по длине: он форматируется порциями по PRINTF_CHUNK байт прямо в терминал,
+ * экран перерисовывает терминал (в командах шелла - один раз в конце команды).
+ *
  * @param fmt строка
  * @param ... аргументы для форматирования
  **/
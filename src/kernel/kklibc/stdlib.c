@@ -7,84 +7,127 @@
 
 #include "stdlib.h"
 
+#include "../cpu/isr.h"
+#include "../cpu/timer.h"
 #include "ctypes.h"
+#include "math.h"
 #include "mem.h"
 #include "stdio.h"
 
-/**
- * @brief      Алгоритм Fuzzy search
- *
- * @param[in]  text         Текст
- * @param[in]  query        Запрос
- * @param[in]  build_score  Оценка за построение
- * @param      score        Оценка
- * @param      score_len    Длина оценка
- *
- * @return int Оценка
- */
-int fuzzy_search(const char* text, const char* query, int build_score, int** score, u32* score_len) {
-    u32 total_score = 0;
-    if (build_score) {    // Build score is an optimization when searching through large database
-        (*score) = (int*)kmalloc(sizeof(int) * strlen(text));
-        memset(*score, 0, sizeof(int) * strlen(text));
-        *score_len = strlen(text);
-    }
-
-    u32 first_character_boosts = 1;
-
-    for (u32 t_idx = 0; t_idx < strlen(text); t_idx++) {
-        char t =
-            tolower(text[t_idx]);    // NOTE(deter0): to lower performs kind of strangely probably due to UTF8
-        for (u32 q_idx = 0; q_idx < strlen(query); q_idx++) {
-            char q = tolower(query[q_idx]);
-
-            if (t == q) {
-                // Start of word awards more but falls off fast
-                if (t_idx == 0 || (t_idx > 0 && isspace(text[t_idx - 1]))) {
-                    int factor = 8 / (first_character_boosts++);
-
-                    if (build_score) {
-                        (*score)[t_idx] += factor;
-                    }
-                    total_score += factor;
-                } else {
-                    if (build_score) {
-                        (*score)[t_idx]++;
-                    }
-                    total_score++;
-                }
+/* Нечеткий поиск: запрос компилируется в маски символов, строка проходится один раз.
+ * state - подпоследовательность (бит i: query[0..i] уже встретился по порядку),
+ * exact - shift-and для вхождения запроса целиком. */
 
-                u32 streak = 0;
-                for (u32 s_idx = 1; s_idx < strlen(query) - q_idx; s_idx++) {
-                    char sq = tolower(query[q_idx + s_idx]);
-                    char st = tolower(text[t_idx + s_idx]);
-
-                    if (sq != st) {
-                        break;
-                    }
-                    streak++;
-
-                    // Beginning of string yields few points more; eg -> "Term" :: "Terminus", "Fluent
-                    // Terminal"
-                    if (((float)t_idx / (float)strlen(text)) <= 0.35) {
-                        streak++;
-                    }
-
-                    int factor = streak * 3 / (strlen(query) * 0.2);
-                    if (build_score) {
-                        (*score)[t_idx + s_idx] += factor;
-                    }
-                    total_score += factor;
-                }
+// начало слова: начало строки или символ после пробела и разделителей имени файла
+static int fuzzy_word_start(const char* text, u32 i) {
+    if (i == 0) {
+        return 1;
+    }
+
+    char prev = text[i - 1];
+    return isspace(prev) || prev == '.' || prev == '_' || prev == '-' || prev == '/';
+}
+
+static int fuzzy_score(const fuzzy_pattern_t* pattern, const char* text, int* per_char) {
+    u32 len = strlen((char*)text);
+    u32 state = 0;
+    u32 exact = 0;
+    u32 prev_advanced = 0;
+    u32 streak = 0;
+    u32 boosts = 1;
+    int total = 0;
+
+    for (u32 i = 0; i < len; i++) {
+        u32 mask = pattern->masks[(u8)text[i]];
+        int points = 0;
+
+        exact = ((exact << 1) | 1) & mask;
+        if (exact & pattern->accept) {
+            points += pattern->length * 4;
+        }
+
+        u32 advanced = ((state << 1) | 1) & mask & ~state;
+        if (advanced) {
+            state |= advanced;
+            points++;
 
-                // (N * (N + 1) ) /2
-                // (*score)[t_idx] += (streak * (streak + 1)) / 2;
-                t_idx += streak;
+            if (fuzzy_word_start(text, i)) {
+                points += 8 / boosts++;    // начало слова дает больше, но быстро убывает
             }
+
+            if (prev_advanced) {
+                streak++;
+                points += streak * 3;
+                if (i * 20 <= len * 7) {    // серия в первых 35% строки: "Term" -> "Terminus"
+                    points += streak;
+                }
+            } else {
+                streak = 0;
+            }
+        }
+        prev_advanced = advanced;
+
+        if (per_char) {
+            per_char[i] += points;
         }
+        total += points;
     }
 
-    return total_score;
+    return (state & pattern->accept) ? total : 0;
+}
+
+int fuzzy_compile(fuzzy_pattern_t* pattern, const char* query) {
+    u32 length = strlen((char*)query);
+
+    if (length == 0 || length > FUZZY_MAX_QUERY) {
+        return 0;
+    }
+
+    memset(pattern->masks, 0, sizeof(pattern->masks));
+    for (u32 i = 0; i < length; i++) {
+        pattern->masks[(u8)tolower(query[i])] |= 1u << i;
+        pattern->masks[(u8)toupper(query[i])] |= 1u << i;
+    }
+
+    pattern->length = length;
+    pattern->accept = 1u << (length - 1);
+    return 1;
+}
+
+int fuzzy_match(const fuzzy_pattern_t* pattern, const char* text) {
+    return fuzzy_score(pattern, text, NULL);
+}
+
+u32 fuzzy_match_batch(const fuzzy_pattern_t* pattern, const char** texts, u32 count, int* scores) {
+    u32 matched = 0;
+
+    for (u32 i = 0; i < count; i++) {
+        scores[i] = fuzzy_score(pattern, texts[i], NULL);
+        matched += scores[i] > 0;
+    }
+
+    return matched;
+}
+
+int fuzzy_search(const char* text, const char* query, int build_score, int** score, u32* score_len) {
+    fuzzy_pattern_t pattern;
+
+    if (build_score) {
+        *score_len = strlen((char*)text);
+        *score = (int*)kmalloc(sizeof(int) * *score_len);
+        if (*score) {
+            memset(*score, 0, sizeof(int) * *score_len);
+        } else {
+            *score_len = 0;
+            build_score = 0;    // нет памяти - считаем только общую оценку
+        }
+    }
+
+    if (!fuzzy_compile(&pattern, query)) {
+        return 0;
+    }
+
+    return fuzzy_score(&pattern, text, build_score ? *score : NULL);
 }
 
 void booltochar(u8 value, u8* str) {
@@ -95,73 +138,140 @@ void booltochar(u8 value, u8* str) {
     }
 }
 
-void itoa(int num, char* str, int base) {
-    int i = 0;
-    u8 isNegative = 0;
+/* Десятичные цифры выводятся парами из таблицы: одно деление на 100 дает две цифры.
+ * 64-битные числа режутся на куски по 8 цифр делением 64/32 (div64_u32), остальное - в u32.
+ * Длина известна заранее, поэтому цифры пишутся сразу на место. */
+static const char digit_pairs[201] = "00010203040506070809"
+                                     "10111213141516171819"
+                                     "20212223242526272829"
+                                     "30313233343536373839"
+                                     "40414243444546474849"
+                                     "50515253545556575859"
+                                     "60616263646566676869"
+                                     "70717273747576777879"
+                                     "80818283848586878889"
+                                     "90919293949596979899";
 
-    if (num == 0) {
-        str[i++] = '0';
-        str[i] = '\0';
-        return;
+static const char hex_digits[] = "0123456789abcdef";
+
+static const u32 powers_of_10[10] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+static u32 dec32_length(u32 num) {
+    u32 len = 1;
+    while (len < 10 && num >= powers_of_10[len]) {
+        len++;
     }
+    return len;
+}
 
-    if (num < 0 && base == 10) {
-        isNegative = 1;
-        num = -num;
+// цифры num справа налево, заканчивая перед end
+static void dec32_backward(u32 num, char* end) {
+    while (num >= 100) {
+        u32 pair = (num % 100) * 2;
+        num /= 100;
+        *--end = digit_pairs[pair + 1];
+        *--end = digit_pairs[pair];
     }
 
-    while (num != 0) {
-        int rem = num % base;
-        str[i++] = (rem > 9) ? (rem - 10) + 'a' : rem + '0';
-        num = num / base;
+    if (num >= 10) {
+        *--end = digit_pairs[num * 2 + 1];
+        *--end = digit_pairs[num * 2];
+    } else {
+        *--end = '0' + num;
     }
+}
+
+u32 utoa_dec(u64 num, char* str) {
+    u32 chunks[2];    // младшие куски по 8 цифр (2^64 < 10^20)
+    u32 count = 0;
 
-    if (isNegative) {
-        str[i++] = '-';
+    while (num >> 32) {
+        num = div64_u32(num, 100000000, &chunks[count++]);
     }
 
-    str[i] = '\0';
+    u32 len = dec32_length((u32)num);
+    dec32_backward((u32)num, str + len);
 
-    // Reverse the string
-    int start = 0;
-    int end = i - 1;
-    while (start < end) {
-        char temp = str[start];
-        str[start] = str[end];
-        str[end] = temp;
-        start++;
-        end--;
+    while (count > 0) {
+        u32 chunk = chunks[--count];
+        char* end = str + len + 8;
+
+        for (u32 i = 0; i < 4; i++) {
+            u32 pair = (chunk % 100) * 2;
+            chunk /= 100;
+            *--end = digit_pairs[pair + 1];
+            *--end = digit_pairs[pair];
+        }
+        len += 8;
     }
+
+    str[len] = '\0';
+    return len;
 }
 
-// Helper function for unsigned integer to string conversion
-void utoa(u32 num, char* str, int base) {
-    int i = 0;
+u32 utoa_hex(u64 num, char* str) {
+    u32 high = (u32)(num >> 32);
+    u32 low = (u32)num;
+    u32 top = high ? high : low;
+    u32 len = 1;
 
-    if (num == 0) {
-        str[i++] = '0';
-        str[i] = '\0';
-        return;
+    if (top) {
+        u32 bit;
+        __asm__("bsr %1, %0" : "=r"(bit) : "rm"(top));
+        len = bit / 4 + 1;
+    }
+    if (high) {
+        len += 8;
     }
 
-    while (num != 0) {
-        int rem = num % base;
-        str[i++] = (rem > 9) ? (rem - 10) + 'a' : rem + '0';
-        num = num / base;
+    str[len] = '\0';
+    for (char* end = str + len; end > str;) {
+        *--end = hex_digits[low & 0xF];
+        low = (low >> 4) | (high << 28);
+        high >>= 4;
     }
 
-    str[i] = '\0';
+    return len;
+}
+
+// любое основание от 2 до 36: по цифре за деление
+static void utoa_generic(u64 num, char* str, int base) {
+    char tmp[64];
+    char* end = tmp + sizeof(tmp);
+    char* start = end;
+
+    do {
+        u32 rem;
+        num = div64_u32(num, base, &rem);
+        *--start = (rem > 9) ? (rem - 10) + 'a' : rem + '0';
+    } while (num != 0);
+
+    memcpy(str, start, end - start);
+    str[end - start] = '\0';
+}
+
+void ulltoa(u64 num, char* str, int base) {
+    if (base == 10) {
+        utoa_dec(num, str);
+    } else if (base == 16) {
+        utoa_hex(num, str);
+    } else {
+        utoa_generic(num, str, base);
+    }
+}
 
-    // Reverse the string
-    int start = 0;
-    int end = i - 1;
-    while (start < end) {
-        char temp = str[start];
-        str[start] = str[end];
-        str[end] = temp;
-        start++;
-        end--;
+void itoa(int num, char* str, int base) {
+    if (num < 0 && base == 10) {
+        *str++ = '-';
+        utoa_dec(-(u32)num, str);
+        return;
     }
+
+    ulltoa((u32)num, str, base);
+}
+
+void utoa(u32 num, char* str, int base) {
+    ulltoa(num, str, base);
 }
 
 int atoi(const char* str) {
@@ -215,76 +325,253 @@ void reboot() {
     __asm__ __volatile__("outb %0, %1" : : "a"(reset_value), "d"(0xCF9) : "memory");
 }
 
-// wait ожидание
+// wait ожидание: процессор спит в hlt до срока по монотонным часам таймера
 void wait(int ms) {
-    volatile int count;
-    while (ms--) {
-        count = 100000;
-        while (count--) {
-            __asm__("nop");
-        }
+    if (ms > 0) {
+        timer_sleep_ns((u64)ms * NS_PER_MS);
+    }
+}
+
+/* Варианты копирования и заполнения выбираются в memops_init по флагам CPUID:
+ * - до MEMOPS_SMALL байт - rep movsb/stosb (дешевле всего на коротких блоках);
+ * - средние блоки - выравнивание назначения на 4 байта, rep movsd/stosd и хвост rep movsb/stosb,
+ *   при ERMSB - сразу rep movsb/stosb (микрокод сам копирует крупными порциями);
+ * - от MEMOPS_NT_THRESHOLD байт при SSE2 - movnti (запись мимо кэша, чтобы не вытеснять
+ *   рабочие данные). movnti пишет из регистров общего назначения, поэтому ядру не нужно
+ *   включать SSE и сохранять XMM-регистры в обработчиках прерываний. */
+static u32 memops_features = 0;
+
+void memops_init(u32 features) {
+    memops_features = features;
+}
+
+u32 memops_get_features() {
+    return memops_features;
+}
+
+static inline void rep_movsb(void* dest, const void* src, u32 n) {
+    __asm__ volatile("rep movsb" : "+D"(dest), "+S"(src), "+c"(n) : : "memory");
+}
+
+static inline void rep_stosb(void* dest, u8 val, u32 n) {
+    __asm__ volatile("rep stosb" : "+D"(dest), "+c"(n) : "a"(val) : "memory");
+}
+
+static void copy_forward(u8* d, const u8* s, u32 n) {
+    if (n < MEMOPS_SMALL || (memops_features & MEMOPS_ERMSB)) {
+        rep_movsb(d, s, n);
+        return;
     }
+
+    u32 head = -(u32)d & 3;
+    u32 dwords = (n - head) >> 2;
+    u32 tail = (n - head) & 3;
+
+    __asm__ volatile("rep movsb\n\t"
+                     "mov %3, %%ecx\n\t"
+                     "rep movsd\n\t"
+                     "mov %4, %%ecx\n\t"
+                     "rep movsb"
+                     : "+D"(d), "+S"(s), "+c"(head)
+                     : "r"(dwords), "r"(tail)
+                     : "memory");
+}
+
+static void copy_backward(u8* d, const u8* s, u32 n) {
+    u32 tail = n & 3;
+    u32 dwords = n >> 2;
+    u8* last_d = d + n - 1;
+    const u8* last_s = s + n - 1;
+
+    // с конца: сначала хвост побайтно, затем двойные слова (флаг DF восстанавливается)
+    __asm__ volatile("std\n\t"
+                     "rep movsb\n\t"
+                     "sub $3, %%esi\n\t"
+                     "sub $3, %%edi\n\t"
+                     "mov %3, %%ecx\n\t"
+                     "rep movsd\n\t"
+                     "cld"
+                     : "+D"(last_d), "+S"(last_s), "+c"(tail)
+                     : "r"(dwords)
+                     : "memory");
+}
+
+static void copy_nontemporal(u8* d, const u8* s, u32 n) {
+    u32 head = -(u32)d & 15;
+    rep_movsb(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    u32 blocks = n >> 4;
+    __asm__ volatile("1:\n\t"
+                     "mov (%1), %%eax\n\t"
+                     "movnti %%eax, (%0)\n\t"
+                     "mov 4(%1), %%eax\n\t"
+                     "movnti %%eax, 4(%0)\n\t"
+                     "mov 8(%1), %%eax\n\t"
+                     "movnti %%eax, 8(%0)\n\t"
+                     "mov 12(%1), %%eax\n\t"
+                     "movnti %%eax, 12(%0)\n\t"
+                     "add $16, %1\n\t"
+                     "add $16, %0\n\t"
+                     "dec %2\n\t"
+                     "jnz 1b\n\t"
+                     "sfence"
+                     : "+r"(d), "+r"(s), "+r"(blocks)
+                     :
+                     : "eax", "memory", "cc");
+
+    rep_movsb(d, s, n & 15);
+}
+
+static void set_forward(u8* d, u8 val, u32 n) {
+    if (n < MEMOPS_SMALL || (memops_features & MEMOPS_ERMSB)) {
+        rep_stosb(d, val, n);
+        return;
+    }
+
+    u32 head = -(u32)d & 3;
+    u32 dwords = (n - head) >> 2;
+    u32 tail = (n - head) & 3;
+
+    __asm__ volatile("rep stosb\n\t"
+                     "mov %2, %%ecx\n\t"
+                     "rep stosl\n\t"
+                     "mov %3, %%ecx\n\t"
+                     "rep stosb"
+                     : "+D"(d), "+c"(head)
+                     : "r"(dwords), "r"(tail), "a"(val * 0x01010101u)
+                     : "memory");
+}
+
+static void set_nontemporal(u8* d, u8 val, u32 n) {
+    u32 head = -(u32)d & 15;
+    rep_stosb(d, val, head);
+    d += head;
+    n -= head;
+
+    u32 blocks = n >> 4;
+    __asm__ volatile("1:\n\t"
+                     "movnti %2, (%0)\n\t"
+                     "movnti %2, 4(%0)\n\t"
+                     "movnti %2, 8(%0)\n\t"
+                     "movnti %2, 12(%0)\n\t"
+                     "add $16, %0\n\t"
+                     "dec %1\n\t"
+                     "jnz 1b\n\t"
+                     "sfence"
+                     : "+r"(d), "+r"(blocks)
+                     : "r"(val * 0x01010101u)
+                     : "memory", "cc");
+
+    rep_stosb(d, val, n & 15);
+}
+
+/* SWAR (SIMD within a register): 4 байта строки проверяются одной операцией.
+ * SWAR_HAS_ZERO выставляет старший бит в каждом нулевом байте слова; самый младший
+ * выставленный бит всегда точный (ложные срабатывания возможны только выше него).
+ * Чтение по выровненным словам не пересекает границу страницы, поэтому может
+ * безопасно захватить байты после конца строки. */
+#define SWAR_ONES 0x01010101u
+#define SWAR_HIGHS 0x80808080u
+#define SWAR_HAS_ZERO(v) (((v) - SWAR_ONES) & ~(v) & SWAR_HIGHS)
+
+typedef u32 __attribute__((may_alias)) swar_word_t;
+typedef u32 __attribute__((may_alias, aligned(1))) swar_uword_t;
+
+static inline u32 swar_lowest_bit(u32 x) {
+    u32 r;
+    __asm__("bsf %1, %0" : "=r"(r) : "rm"(x));
+    return r;
+}
+
+/* SSE2 (MEMOPS_SSE2): 16 байт за сравнение для длинных строк и блоков.
+ * Ядро не сохраняет XMM-регистры при прерываниях, поэтому циклы выполняются с
+ * запрещенными прерываниями. Ядро собирается без -msse, компилятор сам XMM не
+ * использует, поэтому в списках clobber их нет. */
+static const char* sse2_find_zero(const char* p) {    // p выровнен на 16
+    u32 mask;
+    u32 flags = irq_save();
+
+    __asm__ volatile("pxor %%xmm0, %%xmm0\n\t"
+                     "1:\n\t"
+                     "movdqa (%1), %%xmm1\n\t"
+                     "pcmpeqb %%xmm0, %%xmm1\n\t"
+                     "pmovmskb %%xmm1, %0\n\t"
+                     "add $16, %1\n\t"
+                     "test %0, %0\n\t"
+                     "jz 1b"
+                     : "=&r"(mask), "+r"(p)
+                     :
+                     : "memory", "cc");
+
+    irq_restore(flags);
+    return p - 16 + swar_lowest_bit(mask);
+}
+
+static const u8* sse2_find_byte(const u8* p, u32 blocks, u8 c) {    // p выровнен на 16, blocks > 0
+    u32 pattern[4] = { c * SWAR_ONES, c * SWAR_ONES, c * SWAR_ONES, c * SWAR_ONES };
+    u32 mask;
+    u32 flags = irq_save();
+
+    __asm__ volatile("movdqu (%3), %%xmm0\n\t"
+                     "1:\n\t"
+                     "movdqa (%1), %%xmm1\n\t"
+                     "pcmpeqb %%xmm0, %%xmm1\n\t"
+                     "pmovmskb %%xmm1, %0\n\t"
+                     "test %0, %0\n\t"
+                     "jnz 2f\n\t"
+                     "add $16, %1\n\t"
+                     "dec %2\n\t"
+                     "jnz 1b\n\t"
+                     "2:"
+                     : "=&r"(mask), "+r"(p), "+r"(blocks)
+                     : "r"(pattern)
+                     : "memory", "cc");
+
+    irq_restore(flags);
+    return mask ? p + swar_lowest_bit(mask) : NULL;
 }
 
 /* Заполняет область памяти указанным значением */
 void* memset(void* s, int c, unsigned int n) {
-    unsigned char* p = (unsigned char*)s;
-    while (n--) {
-        *p++ = (unsigned char)c;
+    if (n >= MEMOPS_NT_THRESHOLD && (memops_features & MEMOPS_NT)) {
+        set_nontemporal((u8*)s, (u8)c, n);
+    } else {
+        set_forward((u8*)s, (u8)c, n);
     }
     return s;
 }
 
 /* Копирует блок памяти из источника в назначение */
 void* memcpy(void* dest, const void* src, unsigned int n) {
-    unsigned char* d = (unsigned char*)dest;
-    const unsigned char* s = (const unsigned char*)src;
-    while (n--) {
-        *d++ = *s++;
+    if (n >= MEMOPS_NT_THRESHOLD && (memops_features & MEMOPS_NT)) {
+        copy_nontemporal((u8*)dest, (const u8*)src, n);
+    } else {
+        copy_forward((u8*)dest, (const u8*)src, n);
     }
     return dest;
 }
 
 void memory_copy(u8* source, u8* dest, int nbytes) {    // копируем память
-    int i;
-    for (i = 0; i < nbytes; i++) {
-        *(dest + i) = *(source + i);
+    // используется для прокрутки экрана, где области перекрываются
+    if (nbytes > 0) {
+        memmove(dest, source, nbytes);
     }
 }
 
 void memory_set(u8* dest, u8 val, u32 len) {    // задаем память
-    u8* temp = (u8*)dest;
-    for (; len != 0; len--) {
-        *temp++ = val;
-    }
+    memset(dest, val, len);
 }
 
 void u32memory_set(u32* dest, u32 val, u32 len) {    // задаем память u32
-    u32* temp = (u32*)dest;
-    for (; len != 0; len--) {
-        *temp++ = val;
-    }
+    __asm__ volatile("rep stosl" : "+D"(dest), "+c"(len) : "a"(val) : "memory");
 }
 
-/**
- * K&R Реализация
- */
+// legacy: то же, что itoa(n, str, 10)
 void int_to_ascii(int n, char str[]) {
-    int i, sign;
-    if ((sign = n) < 0) {
-        n = -n;
-    }
-    i = 0;
-    do {
-        str[i++] = n % 10 + '0';
-    } while ((n /= 10) > 0);
-
-    if (sign < 0) {
-        str[i++] = '-';
-    }
-    str[i] = '\0';
-
-    reverse(str);
+    itoa(n, str, 10);
 }
 
 int strtoint(char* str) {
@@ -299,33 +586,11 @@ int strtoint(char* str) {
     return rc;
 }
 
-void hex_to_ascii(int n, char str[]) {    // из hex в строку
-    append(str, '0');
-    append(str, 'x');
-
-    char zeros = 0;
-
-    s32 tmp;
-    int i;
-    for (i = 28; i > 0; i -= 4) {
-        tmp = (n >> i) & 0xF;
-        if (tmp == 0 && zeros == 0) {
-            continue;
-        }
-        zeros = 1;
-        if (tmp > 0xA) {
-            append(str, tmp - 0xA + 'a');
-        } else {
-            append(str, tmp + '0');
-        }
-    }
-
-    tmp = n & 0xF;
-    if (tmp >= 0xA) {
-        append(str, tmp - 0xA + 'a');
-    } else {
-        append(str, tmp + '0');
-    }
+void hex_to_ascii(int n, char str[]) {    // из hex в строку (дописывается в конец str)
+    str += strlen(str);
+    *str++ = '0';
+    *str++ = 'x';
+    utoa_hex((u32)n, str);
 }
 
 void strcpy(char* dest, char* src) {    // копирование строки
@@ -361,13 +626,28 @@ void reverse(char s[]) {    // реверс
     }
 }
 
-/* K&R */
 int strlen(char s[]) {    // длина строки
-    int i = 0;
-    while (s[i] != '\0') {
-        ++i;
+    const char* p = s;
+
+    while ((u32)p & 3) {
+        if (*p == '\0') {
+            return p - s;
+        }
+        p++;
+    }
+
+    for (;;) {
+        // длинная строка: с границы 16 байт продолжаем через SSE2
+        if ((memops_features & MEMOPS_SSE2) && p - s >= STR_SSE2_MIN && !((u32)p & 15)) {
+            return sse2_find_zero(p) - s;
+        }
+
+        u32 zero = SWAR_HAS_ZERO(*(const swar_word_t*)p);
+        if (zero) {
+            return p - s + (swar_lowest_bit(zero) >> 3);
+        }
+        p += 4;
     }
-    return i;
 }
 
 void append(char s[], char n) {    // добавление новой строки в исходную
@@ -385,13 +665,32 @@ void backspace(char s[]) {    // бекспейс
 /* K&R
  * Возвращает <0 если s1<s2, 0 если s1==s2, >0 если s1>s2 */
 int strcmp(char s1[], char s2[]) {
-    int i;
-    for (i = 0; s1[i] == s2[i]; i++) {
-        if (s1[i] == '\0') {
-            return 0;
+    // пословно - только при одинаковом выравнивании (иначе одно из чтений пересекало бы слово)
+    if ((((u32)s1 ^ (u32)s2) & 3) == 0) {
+        while ((u32)s1 & 3) {
+            if (*s1 != *s2 || *s1 == '\0') {
+                return *s1 - *s2;
+            }
+            s1++;
+            s2++;
         }
+
+        for (;;) {
+            u32 a = *(const swar_word_t*)s1;
+            if (a != *(const swar_word_t*)s2 || SWAR_HAS_ZERO(a)) {
+                break;
+            }
+            s1 += 4;
+            s2 += 4;
+        }
+    }
+
+    // различие или конец строки - в пределах текущего слова
+    while (*s1 == *s2 && *s1 != '\0') {
+        s1++;
+        s2++;
     }
-    return s1[i] - s2[i];
+    return *s1 - *s2;
 }
 
 unsigned int is_delim(char c, char* delim) {
@@ -487,16 +786,36 @@ int strncmp(const char* s1, const char* s2, unsigned int n) {
 
 // Реализация strchr
 char* strchr(const char* s, int c) {
-    while (*s != '\0') {
-        if (*s == (char)c) {
+    char ch = (char)c;
+    u32 pattern = (u8)ch * SWAR_ONES;
+
+    while ((u32)s & 3) {
+        if (*s == ch) {
             return (char*)s;
         }
+        if (*s == '\0') {
+            return NULL;
+        }
         s++;
     }
-    if (c == '\0') {
-        return (char*)s;
+
+    // пропускаем слова без искомого символа и без конца строки
+    for (;;) {
+        u32 v = *(const swar_word_t*)s;
+        if (SWAR_HAS_ZERO(v) | SWAR_HAS_ZERO(v ^ pattern)) {
+            break;
+        }
+        s += 4;
+    }
+
+    for (;; s++) {
+        if (*s == ch) {
+            return (char*)s;
+        }
+        if (*s == '\0') {
+            return NULL;
+        }
     }
-    return NULL;
 }
 
 // Реализация strstr
@@ -505,16 +824,12 @@ char* strstr(const char* haystack, const char* needle) {
         return (char*)haystack;
     }
 
-    int needle_len = strlen(needle);
-    int haystack_len = strlen(haystack);
+    u32 needle_len = strlen((char*)needle);
 
-    if (needle_len == 0) {
-        return (char*)haystack;
-    }
-
-    for (int i = 0; i <= haystack_len - needle_len; i++) {
-        if (strncmp(haystack + i, needle, needle_len) == 0) {
-            return (char*)(haystack + i);
+    // кандидаты - только позиции первого символа needle, их находит strchr
+    for (const char* p = strchr(haystack, *needle); p; p = strchr(p + 1, *needle)) {
+        if (strncmp(p, needle, needle_len) == 0) {
+            return (char*)p;
         }
     }
     return NULL;
@@ -605,17 +920,11 @@ void* memmove(void* dest, const void* src, u32 n) {
     u8* d = (u8*)dest;
     const u8* s = (const u8*)src;
 
+    // копирование вперед безопасно, если назначение не лежит внутри источника после его начала
     if (s < d && d < s + n) {
-        d += n;
-        s += n;
-        while (n--) {
-            *(--d) = *(--s);
-        }
-
+        copy_backward(d, s, n);
     } else {
-        for (u32 i = 0; i < n; i++) {
-            d[i] = s[i];
-        }
+        copy_forward(d, s, n);
     }
 
     return dest;
@@ -625,21 +934,54 @@ int memcmp(const void* ptr1, const void* ptr2, u32 n) {
     const u8* s1 = (const u8*)ptr1;
     const u8* s2 = (const u8*)ptr2;
 
-    for (u32 i = 0; i < n; i++) {
-        if (s1[i] != s2[i]) {
-            return s1[i] - s2[i];
+    // x86 допускает невыровненные слова, а читаем мы только внутри n байт
+    while (n >= 4 && *(const swar_uword_t*)s1 == *(const swar_uword_t*)s2) {
+        s1 += 4;
+        s2 += 4;
+        n -= 4;
+    }
+
+    for (; n; n--, s1++, s2++) {
+        if (*s1 != *s2) {
+            return *s1 - *s2;
         }
     }
 
-    return (int)NULL;
+    return 0;
 }
 
 void* memchr(const void* ptr, int c, u32 n) {
     const u8* s = (const u8*)ptr;
+    u8 ch = (u8)c;
+
+    if (n >= STR_SSE2_MIN && (memops_features & MEMOPS_SSE2)) {
+        for (; (u32)s & 15; s++, n--) {
+            if (*s == ch) {
+                return (void*)s;
+            }
+        }
+
+        const u8* found = sse2_find_byte(s, n >> 4, ch);
+        if (found) {
+            return (void*)found;
+        }
+        s += n & ~15;
+        n &= 15;
+    }
+
+    u32 pattern = ch * SWAR_ONES;
+    while (n >= 4) {
+        u32 match = SWAR_HAS_ZERO(*(const swar_uword_t*)s ^ pattern);
+        if (match) {
+            return (void*)(s + (swar_lowest_bit(match) >> 3));
+        }
+        s += 4;
+        n -= 4;
+    }
 
-    for (u32 i = 0; i < n; i++) {
-        if (s[i] == (u8)c) {
-            return (void*)(s + i);
+    for (; n; n--, s++) {
+        if (*s == ch) {
+            return (void*)s;
         }
     }
 
@@ -40,6 +40,30 @@ void itoa(int num, char* str, int base);
  */
 void utoa(u32 num, char* str, int base);
 
+/**
+ * @brief Преобразует 64-битное число без знака в строку в указанной системе счисления.
+ * @param num Число для преобразования.
+ * @param str Указатель на буфер для записи результата (до 65 символов для base 2).
+ * @param base Основание системы счисления (от 2 до 36).
+ */
+void ulltoa(u64 num, char* str, int base);
+
+/**
+ * @brief Десятичная запись числа (по две цифры из таблицы за одно деление).
+ * @param num Число для преобразования.
+ * @param str Буфер для результата (минимум 21 символ).
+ * @return Количество цифр.
+ */
+u32 utoa_dec(u64 num, char* str);
+
+/**
+ * @brief Шестнадцатеричная запись числа в нижнем регистре, без префикса (по таблице полубайтов).
+ * @param num Число для преобразования.
+ * @param str Буфер для результата (минимум 17 символов).
+ * @return Количество цифр.
+ */
+u32 utoa_hex(u64 num, char* str);
+
 /**
  * @brief (legacy, используйте itoa) Преобразует целое число в строку ASCII.
  * @param n Число для преобразования.
@@ -48,9 +72,9 @@ void utoa(u32 num, char* str, int base);
 void int_to_ascii(int n, char str[]);
 
 /**
- * @brief (legacy, используйте itoa) Преобразует целое число в шестнадцатеричную строку ASCII.
+ * @brief (legacy, используйте utoa) Дописывает число в конец строки в виде "0x...".
  * @param n Число для преобразования.
- * @param str Буфер для записи результата.
+ * @param str Строка, в конец которой пишется результат.
  */
 void hex_to_ascii(int n, char str[]);
 
@@ -197,10 +221,88 @@ char* strtok(char* src_str, char* delim);
  */
 unsigned int is_delim(char c, char* delim);
 
+/*******************************************************************************
+ * Нечеткий поиск
+ ******************************************************************************/
+
+#define FUZZY_MAX_QUERY 32    // по биту маски на символ запроса
+
+/**
+ * @brief Скомпилированный запрос нечеткого поиска.
+ *
+ * masks[c] содержит бит i, если символ c совпадает с i-м символом запроса без учета регистра.
+ */
+typedef struct fuzzy_pattern {
+    u32 masks[256];
+    u32 length;
+    u32 accept;    // бит последнего символа запроса
+} fuzzy_pattern_t;
+
+/**
+ * @brief Компилирует запрос в маски символов (один раз на много строк).
+ * @param pattern Структура для результата.
+ * @param query Запрос, от 1 до FUZZY_MAX_QUERY символов.
+ * @return 1 при успехе, 0 если запрос пуст или слишком длинный.
+ */
+int fuzzy_compile(fuzzy_pattern_t* pattern, const char* query);
+
+/**
+ * @brief Оценивает строку одним проходом по ней.
+ *
+ * Символы запроса должны встречаться в строке по порядку (не обязательно подряд).
+ * Очки добавляются за начала слов, серии подряд идущих символов и вхождение запроса целиком.
+ * @param pattern Скомпилированный запрос.
+ * @param text Проверяемая строка.
+ * @return Оценка (больше - лучше) или 0, если строка не подходит.
+ */
+int fuzzy_match(const fuzzy_pattern_t* pattern, const char* text);
+
+/**
+ * @brief Оценивает набор строк одним вызовом (имена файлов, команды шелла).
+ * @param pattern Скомпилированный запрос.
+ * @param texts Массив строк.
+ * @param count Количество строк.
+ * @param scores Массив из count оценок (0 - строка не подходит).
+ * @return Количество подошедших строк.
+ */
+u32 fuzzy_match_batch(const fuzzy_pattern_t* pattern, const char** texts, u32 count, int* scores);
+
+/**
+ * @brief Нечеткий поиск одной строки с оценкой по символам.
+ * @param text Текст.
+ * @param query Запрос.
+ * @param build_score 1 - выделить и заполнить массив оценок по символам текста.
+ * @param score Указатель на массив оценок (выделяется через kmalloc, освобождает вызывающий).
+ * @param score_len Длина массива оценок.
+ * @return Общая оценка или 0, если текст не подходит.
+ */
+int fuzzy_search(const char* text, const char* query, int build_score, int** score, u32* score_len);
+
 /*******************************************************************************
  * Работа с памятью
  ******************************************************************************/
 
+#define MEMOPS_ERMSB 0x01    // быстрые rep movsb/stosb (CPUID.07H:EBX[9])
+#define MEMOPS_NT 0x02    // movnti для крупных блоков (SSE2, CPUID.01H:EDX[26])
+#define MEMOPS_SSE2 0x04    // SSE2 включен в CR4 - strlen/memchr по 16 байт
+#define MEMOPS_SMALL 32    // до этого размера - всегда rep movsb/stosb
+#define MEMOPS_NT_THRESHOLD 0x40000    // с этого размера запись идет мимо кэша
+#define STR_SSE2_MIN 64    // strlen/memchr переходят на SSE2 после стольких байт
+
+/**
+ * @brief Выбор вариантов memcpy/memset по возможностям процессора (вызывается из detect_cpu)
+ *
+ * @param features флаги MEMOPS_*
+ **/
+void memops_init(u32 features);
+
+/**
+ * @brief Флаги MEMOPS_*, выбранные memops_init
+ *
+ * @return u32
+ **/
+u32 memops_get_features();
+
 /**
  * @brief Копирует блок памяти из src в dest.
  * @param dest Указатель на назначение.
@@ -339,6 +441,7 @@ void reboot();
 
 /**
  * @brief Приостанавливает выполнение на указанное количество миллисекунд.
+ * Точность задает TSC, откалиброванный по PIT; в ожидании процессор спит в hlt.
  * @param ms Время задержки в миллисекундах.
  */
 void wait(int ms);